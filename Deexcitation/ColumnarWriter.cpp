@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <iterator>
+#include <stdexcept>
+
+#include <G4ios.hh>
+
+#include "Deexcitation/ColumnarWriter.h"
+
+using namespace cola;
+
+namespace {
+  constexpr size_t Alignment = 8;
+
+  constexpr size_t DefaultChunkEvents = 1024;
+} // namespace
+
+ColumnarWriter::ColumnarWriter(const std::string& path, size_t chunkEvents)
+  : chunkEvents_(chunkEvents == 0 ? 1 : chunkEvents) {
+  // new or empty file gets the header, otherwise chunks are appended
+  std::error_code error;
+  const auto fresh = !std::filesystem::exists(path, error) || std::filesystem::file_size(path, error) == 0;
+
+  out_.open(path, std::ios::binary | std::ios::app);
+  if (!out_) {
+    throw std::runtime_error("unable to open columnar output file: " + path);
+  }
+
+  if (fresh) {
+    out_.write(Magic, sizeof(Magic));
+  } else {
+    char magic[sizeof(Magic)] = {};
+    std::ifstream in(path, std::ios::binary);
+    in.read(magic, sizeof(magic));
+    if (!in || !std::equal(std::begin(magic), std::end(magic), std::begin(Magic))) {
+      throw std::runtime_error("not a columnar output file, refusing to append: " + path);
+    }
+  }
+
+  offsets_.push_back(0);
+}
+
+ColumnarWriter::~ColumnarWriter() {
+  // throwing from the destructor would terminate the run
+  try {
+    Flush();
+  } catch (const std::exception& error) {
+    G4cerr << "ColumnarWriter: last chunk is lost, " << error.what() << G4endl;
+  }
+}
+
+void ColumnarWriter::operator()(std::unique_ptr<cola::EventData>&& data) {
+  for (const auto& particle : data->particles) {
+    pdg_.push_back(static_cast<std::int32_t>(particle.pdgCode));
+    px_.push_back(particle.momentum.x);
+    py_.push_back(particle.momentum.y);
+    pz_.push_back(particle.momentum.z);
+    e_.push_back(particle.momentum.e);
+    pClass_.push_back(static_cast<std::uint8_t>(particle.pClass));
+  }
+  offsets_.push_back(pdg_.size());
+
+  // the event isn't kept, so memory is bounded by the chunk size
+  data.reset();
+
+  if (offsets_.size() - 1 >= chunkEvents_) {
+    Flush();
+  }
+}
+
+void ColumnarWriter::Flush() {
+  const std::uint64_t events = offsets_.size() - 1;
+  if (events == 0) {
+    return;
+  }
+
+  const std::uint64_t particles = pdg_.size();
+  out_.write(reinterpret_cast<const char*>(&events), sizeof(events));
+  out_.write(reinterpret_cast<const char*>(&particles), sizeof(particles));
+  WriteColumn(offsets_);
+  WriteColumn(pdg_);
+  WriteColumn(px_);
+  WriteColumn(py_);
+  WriteColumn(pz_);
+  WriteColumn(e_);
+  WriteColumn(pClass_);
+  out_.flush();
+
+  if (!out_) {
+    throw std::runtime_error("failed to write columnar output chunk");
+  }
+
+  // capacity is kept for the next chunk
+  offsets_.assign(1, 0);
+  pdg_.clear();
+  px_.clear();
+  py_.clear();
+  pz_.clear();
+  e_.clear();
+  pClass_.clear();
+}
+
+template <class T>
+void ColumnarWriter::WriteColumn(const std::vector<T>& column) {
+  static const char padding[Alignment] = {};
+
+  const auto bytes = column.size() * sizeof(T);
+  out_.write(reinterpret_cast<const char*>(column.data()), static_cast<std::streamsize>(bytes));
+  if (const auto tail = bytes % Alignment; tail != 0) {
+    out_.write(padding, static_cast<std::streamsize>(Alignment - tail));
+  }
+}
+
+cola::VFilter* ColumnarWriterFactory::create(const std::map<std::string, std::string>& params) {
+  const auto path = params.find("path");
+  if (path == params.end()) {
+    throw std::runtime_error("ColumnarWriter requires a path parameter");
+  }
+
+  auto chunkEvents = DefaultChunkEvents;
+  if (auto it = params.find("chunkEvents"); it != params.end()) {
+    const auto& [_, value] = *it;
+    chunkEvents = std::stoul(value);
+  }
+
+  return new ColumnarWriter(path->second, chunkEvents);
+}
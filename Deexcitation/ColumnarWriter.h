@@ -0,0 +1,56 @@
+#pragma once
+
+#include <COLA.hh>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace cola {
+  // Append-only columnar output of event particles.
+  //
+  // File layout, host byte order (readers on another architecture swap bytes), every block is 8 byte aligned:
+  //   header: char magic[8] = "DXCOLS01"
+  //   chunks until end of file:
+  //     uint64 events, uint64 particles
+  //     uint64 offsets[events + 1]   particles of the i-th event are [offsets[i], offsets[i + 1]) inside the chunk
+  //     int32  pdg[particles]        padded to 8 bytes
+  //     double px[particles], py[particles], pz[particles], e[particles]
+  //     uint8  pClass[particles]     padded to 8 bytes
+  // Only buffered chunk is kept in memory, the file can be memory mapped and walked chunk by chunk.
+  // An existing file is appended to only if it starts with the magic.
+  class ColumnarWriter final : public cola::VWriter {
+  public:
+    static constexpr char Magic[8] = {'D', 'X', 'C', 'O', 'L', 'S', '0', '1'};
+
+    ColumnarWriter(const std::string& path, size_t chunkEvents);
+
+    ~ColumnarWriter();
+
+    void operator()(std::unique_ptr<cola::EventData>&& data) final;
+
+    // writes the buffered events as a chunk, no-op when nothing is buffered; throws on I/O errors
+    void Flush();
+
+  private:
+    template <class T>
+    void WriteColumn(const std::vector<T>& column);
+
+    std::ofstream out_;
+    size_t chunkEvents_;
+
+    std::vector<std::uint64_t> offsets_;
+    std::vector<std::int32_t> pdg_;
+    std::vector<double> px_;
+    std::vector<double> py_;
+    std::vector<double> pz_;
+    std::vector<double> e_;
+    std::vector<std::uint8_t> pClass_;
+  };
+
+  // params: path (required), chunkEvents (events per chunk, 1024 by default)
+  class ColumnarWriterFactory final : public cola::VFactory {
+  public:
+    cola::VFilter* create(const std::map<std::string, std::string>& params) final;
+  };
+} // namespace cola
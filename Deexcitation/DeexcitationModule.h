@@ -1,4 +1,6 @@
 #pragma once
 
+#include "Deexcitation/ColumnarWriter.h"
 #include "Deexcitation/G4HandlerConverter.h"
 #include "Deexcitation/G4HandlerFactory.h"
+#include "Deexcitation/G4HandlerPipeline.h"
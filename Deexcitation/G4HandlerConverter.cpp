@@ -1,13 +1,24 @@
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
 #include <COLA.hh>
 #include <G4NucleiProperties.hh>
+#include <G4ios.hh>
 
 #include "Deexcitation/handler/ExcitationHandler.h"
+#include "Deexcitation/handler/FbuFermiBreakUp.h"
+#include "Deexcitation/handler/HandlerPool.h"
 
 #include "Deexcitation/G4HandlerConverter.h"
 
 using namespace cola;
 
 namespace {
+  bool IsSpectator(const cola::Particle& particle) {
+    return particle.pClass == cola::ParticleClass::spectatorA || particle.pClass == cola::ParticleClass::spectatorB;
+  }
+
   G4Fragment ColaToG4(const cola::Particle& particle) {
     const auto [A, Z] = particle.getAZ();
 
@@ -23,44 +34,299 @@ namespace {
     );
   }
 
-  cola::Particle G4ToCola(const G4ReactionProduct& fragment) {
+  using PdgCode = decltype(cola::Particle::pdgCode);
+
+  // pdg codes of the nuclide chart, computed once
+  class PdgTable {
+   public:
+    static constexpr int MaxA = NuclideChart::MaxA;
+    static constexpr int MaxZ = NuclideChart::MaxZ;
+
+    static const PdgTable& Instance() {
+      static const PdgTable table;
+      return table;
+    }
+
+    PdgCode Get(int A, int Z) const {
+      if (A < 0 || A > MaxA || Z < 0 || Z > MaxZ) {
+        return cola::AZToPdg({A, Z});
+      }
+      return codes_[A * (MaxZ + 1) + Z];
+    }
+
+   private:
+    PdgTable() : codes_((MaxA + 1) * (MaxZ + 1)) {
+      for (int A = 0; A <= MaxA; ++A) {
+        for (int Z = 0; Z <= MaxZ; ++Z) {
+          codes_[A * (MaxZ + 1) + Z] = cola::AZToPdg({A, Z});
+        }
+      }
+    }
+
+    std::vector<PdgCode> codes_;
+  };
+
+  cola::Particle G4ToCola(const G4Fragment& fragment, const PdgTable& pdgTable) {
+    const auto& momentum = fragment.GetMomentum();
     return cola::Particle{
       cola::LorentzVector{0., 0., 0., 0.},
       cola::LorentzVector{
-        fragment.GetTotalEnergy(),
-        fragment.GetMomentum().x(),
-        fragment.GetMomentum().y(),
-        fragment.GetMomentum().z(),
+        momentum.e(),
+        momentum.x(),
+        momentum.y(),
+        momentum.z(),
       },
-      cola::AZToPdg({
-        static_cast<int>(fragment.GetDefinition()->GetAtomicMass()),
-        static_cast<int>(fragment.GetDefinition()->GetAtomicNumber()),
-      }),
+      pdgTable.Get(fragment.GetA_asInt(), fragment.GetZ_asInt()),
       cola::ParticleClass::produced,
     };
   }
+
+  // particles of the i-th spectator are [offsets[i], offsets[i + 1])
+  struct ColaBatch {
+    std::vector<cola::Particle> products;
+    std::vector<size_t> offsets;
+  };
+
+  // final fragments go straight to COLA particles, no G4ReactionProduct is built
+  void BreakBatch(ExcitationHandler& handler, const std::vector<G4Fragment>& fragments, ColaBatch& output,
+                  bool staged) {
+    const auto& pdgTable = PdgTable::Instance();
+
+    if (staged) {
+      output.products.clear();
+      output.offsets.assign(1, 0);
+      handler.BreakItUpStaged(fragments, [&output, &pdgTable](size_t fragmentIdx, const G4Fragment& fragment) {
+        // products come grouped by spectator, skipped spectators have produced nothing
+        while (output.offsets.size() <= fragmentIdx) {
+          output.offsets.push_back(output.products.size());
+        }
+        output.products.emplace_back(G4ToCola(fragment, pdgTable));
+      });
+      output.offsets.resize(fragments.size() + 1, output.products.size());
+      return;
+    }
+
+    const auto sink = ExcitationHandler::FragmentSink([&output, &pdgTable](const G4Fragment& fragment) {
+      output.products.emplace_back(G4ToCola(fragment, pdgTable));
+    });
+
+    output.products.clear();
+    output.offsets.assign(1, 0);
+    for (const auto& fragment : fragments) {
+      handler.BreakItUpFragments(fragment, sink);
+      output.offsets.push_back(output.products.size());
+    }
+  }
+
+  // spectators are split into contiguous chunks, several per thread to even out the load
+  constexpr size_t ChunksPerThread = 4;
+
+  // weight of the last event in the products per spectator estimate
+  constexpr double MultiplicityUpdateRate = 0.1;
 }
 
-G4HandlerConverter::G4HandlerConverter(std::unique_ptr<ExcitationHandler>&& model) : model_(std::move(model)) {}
+struct G4HandlerConverter::Scratch {
+  std::vector<G4Fragment> spectators;
+  ColaBatch products;
 
-std::unique_ptr<cola::EventData> G4HandlerConverter::operator()(std::unique_ptr<cola::EventData>&& data) {
-  cola::EventParticles results;
-  for (const auto& particle : data->particles) {
-    const auto pClass = particle.pClass;
-    if (pClass == cola::ParticleClass::spectatorA || pClass == cola::ParticleClass::spectatorB) {
-      // apply model
-      auto modelResult = model_->BreakItUp(ColaToG4(particle));
-
-      // convert model's results to cola format
-      for (const auto& fragment : modelResult) {
-        results.emplace_back(G4ToCola(fragment));
-        results.back().pClass = pClass;
+  // parallel mode only
+  std::vector<std::vector<G4Fragment>> chunks;
+  std::vector<ColaBatch> chunkResults;
+
+  double multiplicityEstimate = 1.;
+};
+
+G4HandlerConverter::G4HandlerConverter(std::unique_ptr<ExcitationHandler>&& model)
+  : ownedModel_(std::move(model)), model_(ownedModel_.get()), scratch_(std::make_unique<Scratch>()) {}
+
+G4HandlerConverter::G4HandlerConverter(ExcitationHandler& model)
+  : model_(&model), scratch_(std::make_unique<Scratch>()) {}
+
+G4HandlerConverter::G4HandlerConverter(const HandlerBuilder& builder, size_t threads)
+  : pool_(std::make_unique<HandlerPool>(builder, threads)), scratch_(std::make_unique<Scratch>()) {}
+
+G4HandlerConverter::~G4HandlerConverter() {
+  if (dumpStats_) {
+    G4cout << "G4HandlerConverter stats\n" << GetStats()
+           << "budget fallbacks: " << GetFallbackCount() << '\n';
+    double warmUpTime = 0;
+    ForEachHandler([&warmUpTime](const ExcitationHandler& handler) { warmUpTime += handler.GetWarmUpTime().count(); });
+    if (warmUpTime != 0) {
+      G4cout << "warm-up [s]: " << warmUpTime << '\n';
+    }
+#ifdef DEEXCITATION_WITH_FBU
+    size_t hits = 0;
+    size_t misses = 0;
+    ForEachHandler([&hits, &misses](const ExcitationHandler& handler) {
+      if (auto wrapper = dynamic_cast<const FbuFermiBreakUp*>(handler.GetFermiBreakUp().get())) {
+        hits += wrapper->GetCacheHits();
+        misses += wrapper->GetCacheMisses();
       }
-    } else {
-      results.push_back(particle);
+    });
+    if (hits + misses != 0) {
+      G4cout << "fermi break-up split cache: hits " << hits << ", misses " << misses
+             << ", hit rate " << double(hits) / double(hits + misses) << '\n';
+    }
+#endif
+    G4cout << G4endl;
+  }
+}
+
+HandlerStats G4HandlerConverter::GetStats() const {
+  HandlerStats stats;
+  ForEachHandler([&stats](const ExcitationHandler& handler) { stats += handler.GetStats(); });
+  return stats;
+}
+
+size_t G4HandlerConverter::GetFallbackCount() const {
+  size_t count = 0;
+  ForEachHandler([&count](const ExcitationHandler& handler) { count += handler.GetFallbackCount(); });
+  return count;
+}
+
+void G4HandlerConverter::EnableParallelEvaporation(const HandlerBuilder& builder, size_t threads,
+                                                   size_t minFragments) {
+  if (pool_ != nullptr) {
+    throw std::runtime_error("parallel evaporation can't be used when spectators are spread over threads");
+  }
+  evaporationPool_ = std::make_unique<HandlerPool>(builder, threads);
+  model_->SetParallelEvaporation(evaporationPool_.get(), minFragments);
+}
+
+void G4HandlerConverter::ForEachHandler(const std::function<void(const ExcitationHandler&)>& visitor) const {
+  if (pool_ == nullptr) {
+    visitor(*model_);
+    if (evaporationPool_ != nullptr) {
+      evaporationPool_->ForEachHandler(visitor);
+    }
+    return;
+  }
+  pool_->ForEachHandler(visitor);
+}
+
+std::unique_ptr<cola::EventData> G4HandlerConverter::operator()(std::unique_ptr<cola::EventData>&& data) {
+  auto& particles = data->particles;
+  auto& spectators = scratch_->spectators;
+  auto& products = scratch_->products;
+  const auto eventId = nextEventId_++;
+
+  const auto spectatorsCount = static_cast<size_t>(std::count_if(particles.begin(), particles.end(), IsSpectator));
+  if (spectatorsCount == 0) {
+    return std::move(data);
+  }
+
+  spectators.clear();
+  spectators.reserve(spectatorsCount);
+  for (const auto& particle : particles) {
+    if (IsSpectator(particle)) {
+      spectators.emplace_back(ColaToG4(particle));
     }
   }
 
-  data->particles = std::move(results);
+  products.products.reserve(static_cast<size_t>(spectatorsCount * scratch_->multiplicityEstimate) + 1);
+  BreakSpectators(eventId);
+
+  const auto multiplicity = double(products.products.size()) / spectatorsCount;
+  scratch_->multiplicityEstimate += MultiplicityUpdateRate * (multiplicity - scratch_->multiplicityEstimate);
+
+  SpliceProducts(particles);
   return std::move(data);
 }
+
+void G4HandlerConverter::BreakSpectators(std::uint64_t eventId) {
+  auto& spectators = scratch_->spectators;
+  auto& result = scratch_->products;
+
+  if (pool_ == nullptr) {
+    model_->SetStreamPosition(eventId, 0);
+    BreakBatch(*model_, spectators, result, staged_);
+    return;
+  }
+
+  auto& chunks = scratch_->chunks;
+  auto& chunkResults = scratch_->chunkResults;
+
+  const auto chunksCount = std::min(spectators.size(), pool_->GetSize() * ChunksPerThread);
+  const auto chunkSize = (spectators.size() + chunksCount - 1) / chunksCount;
+
+  chunks.resize(chunksCount);
+  chunkResults.resize(chunksCount);
+  for (auto& chunk : chunks) {
+    chunk.clear();
+  }
+  for (size_t idx = 0; idx < spectators.size(); ++idx) {
+    chunks[idx / chunkSize].push_back(spectators[idx]);
+  }
+
+  pool_->Run(chunksCount, [this, &chunks, &chunkResults, eventId, chunkSize](ExcitationHandler& handler,
+                                                                              size_t chunkIdx) {
+    // streams are indexed by the spectator's position in the event, not by the thread
+    handler.SetStreamPosition(eventId, chunkIdx * chunkSize);
+    BreakBatch(handler, chunks[chunkIdx], chunkResults[chunkIdx], staged_);
+  });
+
+  // merge chunks in input order
+  result.products.clear();
+  result.offsets.assign(1, 0);
+  for (size_t chunkIdx = 0; chunkIdx < chunksCount; ++chunkIdx) {
+    auto& chunkResult = chunkResults[chunkIdx];
+    const auto base = result.products.size();
+    result.products.insert(result.products.end(),
+                           std::make_move_iterator(chunkResult.products.begin()),
+                           std::make_move_iterator(chunkResult.products.end()));
+    for (size_t idx = 1; idx < chunkResult.offsets.size(); ++idx) {
+      result.offsets.push_back(base + chunkResult.offsets[idx]);
+    }
+  }
+}
+
+void G4HandlerConverter::SpliceProducts(cola::EventParticles& particles) const {
+  const auto& [products, offsets] = scratch_->products;
+  const auto spectatorsCount = offsets.size() - 1;
+
+  bool everyoneProduced = true;
+  for (size_t idx = 0; idx < spectatorsCount; ++idx) {
+    everyoneProduced &= offsets[idx] != offsets[idx + 1];
+  }
+
+  if (!everyoneProduced) {
+    // spectators may vanish, can't be done in place
+    cola::EventParticles results;
+    results.reserve(particles.size() - spectatorsCount + products.size());
+    size_t spectatorIdx = 0;
+    for (auto& particle : particles) {
+      if (IsSpectator(particle)) {
+        for (auto idx = offsets[spectatorIdx]; idx < offsets[spectatorIdx + 1]; ++idx) {
+          results.emplace_back(products[idx]);
+          results.back().pClass = particle.pClass;
+        }
+        ++spectatorIdx;
+      } else {
+        results.emplace_back(std::move(particle));
+      }
+    }
+    particles = std::move(results);
+    return;
+  }
+
+  // every spectator is replaced by at least one product, so the event only grows
+  // and it can be filled from the back without overwriting unread particles
+  const auto oldSize = particles.size();
+  const auto newSize = oldSize - spectatorsCount + products.size();
+  particles.resize(newSize);
+
+  auto write = newSize;
+  auto spectatorIdx = spectatorsCount;
+  for (auto read = oldSize; read-- > 0;) {
+    if (IsSpectator(particles[read])) {
+      --spectatorIdx;
+      const auto pClass = particles[read].pClass;
+      for (auto idx = offsets[spectatorIdx + 1]; idx-- > offsets[spectatorIdx];) {
+        particles[--write] = products[idx];
+        particles[write].pClass = pClass;
+      }
+    } else if (--write != read) {
+      particles[write] = std::move(particles[read]);
+    }
+  }
+}
@@ -1,18 +1,68 @@
 #pragma once
 
 #include <COLA.hh>
+#include <cstdint>
+#include <functional>
 #include <memory>
 
-class ExcitationHandler;
+#include "Deexcitation/handler/ExcitationHandlerFwd.h"
+#include "Deexcitation/handler/HandlerStats.h"
+
+class HandlerPool;
 
 namespace cola {
   class G4HandlerConverter final : public cola::VConverter {
   public:
+    using HandlerBuilder = std::function<std::unique_ptr<ExcitationHandler>()>;
+
     G4HandlerConverter(std::unique_ptr<ExcitationHandler>&& model);
 
+    // handler is not owned and must outlive the converter, used by the workers of G4HandlerPipeline
+    explicit G4HandlerConverter(ExcitationHandler& model);
+
+    // spectators are spread over threads, each of them owns a handler made by builder
+    G4HandlerConverter(const HandlerBuilder& builder, size_t threads);
+
+    ~G4HandlerConverter();
+
     std::unique_ptr<cola::EventData> operator()(std::unique_ptr<cola::EventData>&& data) final;
 
+    // id of the next event in per-fragment random streams of the handlers, incremented after each event
+    void SetNextEventId(std::uint64_t eventId) { nextEventId_ = eventId; }
+
+    // stats of all handlers, they are collected only by handlers with enabled stats
+    HandlerStats GetStats() const;
+
+    // fragments emitted by the work budget fallback of all handlers
+    size_t GetFallbackCount() const;
+
+    // stats are printed to G4cout, when the converter is destroyed at the end of a run
+    void SetDumpStats(bool dump) { dumpStats_ = dump; }
+
+    // spectators of an event are de-excited stage by stage instead of one by one
+    void SetStaged(bool staged) { staged_ = staged; }
+
+    // single handler mode only, multifragmentation products of a spectator are evaporated on threads
+    // with handlers made by builder, when there are at least minFragments of them
+    void EnableParallelEvaporation(const HandlerBuilder& builder, size_t threads, size_t minFragments);
+
   private:
-    std::unique_ptr<ExcitationHandler> model_;
+    // buffers reused between events
+    struct Scratch;
+
+    void ForEachHandler(const std::function<void(const ExcitationHandler&)>& visitor) const;
+
+    void BreakSpectators(std::uint64_t eventId);
+
+    void SpliceProducts(cola::EventParticles& particles) const;
+
+    std::unique_ptr<ExcitationHandler> ownedModel_;
+    ExcitationHandler* model_ = nullptr;
+    std::unique_ptr<HandlerPool> pool_;
+    std::unique_ptr<HandlerPool> evaporationPool_;
+    std::unique_ptr<Scratch> scratch_;
+    bool dumpStats_ = false;
+    bool staged_ = false;
+    std::uint64_t nextEventId_ = 0;
   };
 } // namespace cola
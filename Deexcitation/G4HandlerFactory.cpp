@@ -1,11 +1,18 @@
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <optional>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <G4FermiBreakUpAN.hh>
 #include <Randomize.hh>
 
 #include "Deexcitation/handler/ExcitationHandler.h"
+#include "Deexcitation/handler/FbuFermiBreakUp.h"
 
 #include "Deexcitation/G4HandlerFactory.h"
 
@@ -37,6 +44,61 @@ namespace {
     return num;
   }
 
+  std::pair<int, int> ParseBounds(const std::string& value) {
+    const auto dash = value.find('-');
+    if (dash == std::string::npos) {
+      const auto bound = std::stoi(value);
+      return {bound, bound};
+    }
+    return {std::stoi(value.substr(0, dash)), std::stoi(value.substr(dash + 1))};
+  }
+
+  // "minZ-maxZ:minA-maxA" entries separated by commas, e.g. "1-8:1-20,26:50-60"
+  std::vector<NuclideRange> ParseNuclideRanges(const std::string& value) {
+    std::vector<NuclideRange> ranges;
+    std::stringstream ss(value);
+    std::string entry;
+    while (std::getline(ss, entry, ',')) {
+      const auto colon = entry.find(':');
+      if (colon == std::string::npos) {
+        throw std::runtime_error("nuclide range must look like minZ-maxZ:minA-maxA, but got: " + entry);
+      }
+      const auto [minZ, maxZ] = ParseBounds(entry.substr(0, colon));
+      const auto [minA, maxA] = ParseBounds(entry.substr(colon + 1));
+      if (minZ < 0 || minZ > maxZ || maxZ > NuclideChart::MaxZ || minA < 1 || minA > maxA || maxA > NuclideChart::MaxA) {
+        throw std::runtime_error("nuclide range must lie within Z 0-" + std::to_string(NuclideChart::MaxZ)
+                                 + ", A 1-" + std::to_string(NuclideChart::MaxA) + ", but got: " + entry);
+      }
+      ranges.push_back(NuclideRange{minZ, maxZ, minA, maxA});
+    }
+    return ranges;
+  }
+
+  IonTableMode ParseIonTableMode(const std::string& value) {
+    if (value == "eager") {
+      return IonTableMode::Eager;
+    }
+    if (value == "lazy") {
+      return IonTableMode::Lazy;
+    }
+    throw std::runtime_error("ionTable must be eager or lazy, but got: " + value);
+  }
+
+#ifdef DEEXCITATION_WITH_FBU
+  std::unique_ptr<fbu::FermiBreakUp::SplitCache> MakeSplitCache(const std::string& name, size_t size) {
+    if (name == "none") {
+      return nullptr;
+    }
+    if (name == "simple") {
+      return std::make_unique<fbu::SimpleCache<fbu::NucleiData, fbu::FragmentSplits>>();
+    }
+    if (name == "lfu") {
+      return std::make_unique<fbu::LFUCache<fbu::NucleiData, fbu::FragmentSplits>>(size);
+    }
+    throw std::runtime_error("fermiCache must be none, simple or lfu, but got: " + name);
+  }
+#endif
+
   struct Config {
     Config(const std::map<std::string, std::string>& params) {
       if (auto it = params.find("A"); it != params.end()) {
@@ -63,6 +125,92 @@ namespace {
         const auto& [_, value] = *it;
         stableThreshold = StodWithFactor(value);
       }
+
+      if (auto it = params.find("threads"); it != params.end()) {
+        const auto& [_, value] = *it;
+        threads = std::stoul(value);
+      }
+
+      if (auto it = params.find("budgetIterations"); it != params.end()) {
+        const auto& [_, value] = *it;
+        budgetIterations = std::stoul(value);
+      }
+
+      if (auto it = params.find("budgetTimeMs"); it != params.end()) {
+        const auto& [_, value] = *it;
+        budgetTimeMs = std::stod(value);
+      }
+
+      if (auto it = params.find("fermiBreakUp"); it != params.end()) {
+        const auto& [_, value] = *it;
+        fermiBreakUp = value;
+      }
+
+      if (auto it = params.find("fermiCache"); it != params.end()) {
+        const auto& [_, value] = *it;
+        fermiCache = value;
+      }
+
+      if (auto it = params.find("fermiCacheSize"); it != params.end()) {
+        const auto& [_, value] = *it;
+        fermiCacheSize = std::stoul(value);
+      }
+
+      if (auto it = params.find("streamSeed"); it != params.end()) {
+        const auto& [_, value] = *it;
+        streamSeed = std::stoull(value);
+      }
+
+      if (auto it = params.find("stats"); it != params.end()) {
+        const auto& [_, value] = *it;
+        stats = value == "true" || value == "1";
+      }
+
+      if (auto it = params.find("parallelEvaporationThreads"); it != params.end()) {
+        const auto& [_, value] = *it;
+        parallelEvaporationThreads = std::stoul(value);
+      }
+
+      if (auto it = params.find("parallelEvaporationMinFragments"); it != params.end()) {
+        const auto& [_, value] = *it;
+        parallelEvaporationMinFragments = std::stoul(value);
+      }
+
+      if (auto it = params.find("pipelineThreads"); it != params.end()) {
+        const auto& [_, value] = *it;
+        pipelineThreads = std::stoul(value);
+      }
+
+      if (auto it = params.find("pipelineInFlight"); it != params.end()) {
+        const auto& [_, value] = *it;
+        pipelineInFlight = std::stoul(value);
+      }
+
+      if (auto it = params.find("staged"); it != params.end()) {
+        const auto& [_, value] = *it;
+        staged = value == "true" || value == "1";
+      }
+
+      if (auto it = params.find("ionTable"); it != params.end()) {
+        const auto& [_, value] = *it;
+        ionTableMode = ParseIonTableMode(value);
+      }
+
+      if (auto it = params.find("warmUp"); it != params.end()) {
+        const auto& [_, value] = *it;
+        warmUp = ParseNuclideRanges(value);
+      }
+
+      if (auto it = params.find("prewarmIons"); it != params.end()) {
+        const auto& [_, value] = *it;
+        prewarmIons = ParseNuclideRanges(value);
+      }
+
+      // zero limits mean unlimited, so a budget needs at least one of them
+      if ((budgetIterations.has_value() || budgetTimeMs.has_value())
+          && budgetIterations.value_or(0) == 0 && budgetTimeMs.value_or(0) <= 0) {
+        throw std::runtime_error("budgetIterations or budgetTimeMs must be positive");
+      }
     }
 
     std::optional<int> A;
@@ -70,49 +218,112 @@ namespace {
     std::optional<double> stableThreshold;
     std::optional<double> lowerMfThreshold;
     std::optional<double> upperMfThreshold;
+    std::optional<size_t> threads;
+    std::optional<IonTableMode> ionTableMode;
+    std::optional<size_t> budgetIterations;
+    std::optional<double> budgetTimeMs;
+    std::string fermiBreakUp = "g4";
+    std::string fermiCache = "lfu";
+    size_t fermiCacheSize = 1000;
+    std::optional<std::uint64_t> streamSeed;
+    bool stats = false;
+    bool staged = false;
+    size_t parallelEvaporationThreads = 0;
+    size_t parallelEvaporationMinFragments = 8;
+    size_t pipelineThreads = 2;
+    std::optional<size_t> pipelineInFlight;
+    std::vector<NuclideRange> prewarmIons;
+    std::vector<NuclideRange> warmUp;
   };
-}
 
-cola::G4HandlerConverter* G4HandlerFactory::DoCreate(const std::map<std::string, std::string>& params) {
-  auto config = Config(params);
+  std::unique_ptr<ExcitationHandler> BuildHandler(const Config& config) {
+    auto model = std::make_unique<ExcitationHandler>(config.ionTableMode.value_or(IonTableMode::Eager));
 
-  auto model = std::make_unique<ExcitationHandler>();
+    if (config.fermiBreakUp == "fbu") {
+#ifdef DEEXCITATION_WITH_FBU
+      model->SetFermiBreakUp(FbuFermiBreakUp::Create(MakeSplitCache(config.fermiCache, config.fermiCacheSize)));
+#else
+      throw std::runtime_error("fermiBreakUp = fbu requires the library built with FermiBreakUp");
+#endif
+    } else if (config.fermiBreakUp != "g4") {
+      throw std::runtime_error("fermiBreakUp must be g4 or fbu, but got: " + config.fermiBreakUp);
+    }
 
-  if (config.stableThreshold.has_value()) {
-    model->SetStableThreshold(*config.stableThreshold);
-  }
+    if (config.stableThreshold.has_value()) {
+      model->SetStableThreshold(*config.stableThreshold);
+    }
 
-  model->SetFermiBreakUpCondition([maxA=config.A.value_or(MAX_A), maxZ=config.Z.value_or(MAX_Z)] (const G4Fragment& fragment) {
-    return fragment.GetZ_asInt() < maxZ && fragment.GetA_asInt() < maxA;
-  });
+    model->SetFermiBreakUpCondition(DefaultConditions::FermiBreakUp{
+      config.A.value_or(MAX_A),
+      config.Z.value_or(MAX_Z),
+    });
 
-  model->SetMultiFragmentationCondition([
-      maxA=config.A.value_or(MAX_A),
-      maxZ=config.Z.value_or(MAX_Z),
-      lowerBoundTransitionMF=config.lowerMfThreshold.value_or(3 * CLHEP::MeV),
-      upperBoundTransitionMF=config.upperMfThreshold.value_or(5 * CLHEP::MeV)
-    ] (const G4Fragment& fragment) {
-      auto A = fragment.GetA_asInt();
-      auto Z = fragment.GetZ_asInt();
-      auto Ex = fragment.GetExcitationEnergy();
-      if (A < maxA && Z < maxZ) {
-        return false;
-      }
-      G4double aE = 1 / (2. * (upperBoundTransitionMF - lowerBoundTransitionMF));
-      G4double E0 = (upperBoundTransitionMF + lowerBoundTransitionMF) / 2.;
-      G4double w = G4RandFlat::shoot();
-      G4double transF = 0.5 * std::tanh((Ex / A - E0) / aE) + 0.5;
+    model->SetMultiFragmentationCondition(DefaultConditions::MultiFragmentation{
+      config.A.value_or(MAX_A),
+      config.Z.value_or(MAX_Z),
+      config.lowerMfThreshold.value_or(3 * CLHEP::MeV),
+      config.upperMfThreshold.value_or(5 * CLHEP::MeV),
+    });
+
+    if (config.budgetIterations.has_value() || config.budgetTimeMs.has_value()) {
+      model->SetWorkBudget(ExcitationHandler::WorkBudget{
+        config.budgetIterations.value_or(0),
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::duration<double, std::milli>(config.budgetTimeMs.value_or(0))),
+      });
+    }
 
-      if (Ex < lowerBoundTransitionMF * A) { return false; }
+    if (config.streamSeed.has_value()) {
+      model->EnableRandomStreams(*config.streamSeed);
+    }
+
+    model->EnableStats(config.stats);
 
-      if (w < transF && Ex < upperBoundTransitionMF * A) { return true; }
+    for (const auto& range : config.prewarmIons) {
+      model->PrewarmIons(range);
+    }
 
-      if (w > transF && Ex < upperBoundTransitionMF * A) { return false; }
+    // after all models are set, so the configured ones are initialized
+    for (const auto& range : config.warmUp) {
+      model->WarmUp(range);
+    }
 
-      if (Ex > upperBoundTransitionMF * A) { return true; }
+    return model;
+  }
+}
 
-      return false;
-  });
+cola::G4HandlerConverter* G4HandlerFactory::DoCreate(const std::map<std::string, std::string>& params) {
+  auto config = Config(params);
+  if (config.threads.value_or(1) > 1 && !config.streamSeed.has_value()) {
+    // worker engines would be drawn in scheduling order, so the output wouldn't match the serial run
+    throw std::runtime_error("threads > 1 requires streamSeed");
+  }
+  if (config.parallelEvaporationThreads > 1 && !config.streamSeed.has_value()) {
+    // products would be evaporated by whichever worker is free, with its own engine
+    throw std::runtime_error("parallelEvaporationThreads > 1 requires streamSeed");
+  }
+
+  auto converter = std::unique_ptr<G4HandlerConverter>(
+      config.threads.value_or(1) > 1
+      ? new G4HandlerConverter([config] { return BuildHandler(config); }, *config.threads)
+      : new G4HandlerConverter(BuildHandler(config)));
+  converter->SetDumpStats(config.stats);
+  converter->SetStaged(config.staged);
+  if (config.parallelEvaporationThreads > 1) {
+    converter->EnableParallelEvaporation([config] { return BuildHandler(config); },
+                                         config.parallelEvaporationThreads, config.parallelEvaporationMinFragments);
+  }
+
+  return converter.release();
+}
+
+std::unique_ptr<G4HandlerPipeline> G4HandlerFactory::CreatePipeline(const std::map<std::string, std::string>& params) {
+  auto config = Config(params);
+  if (!config.streamSeed.has_value()) {
+    // events would be de-excited by whichever worker is free, so the output would depend on scheduling
+    throw std::runtime_error("pipeline requires streamSeed");
+  }
 
-  return new G4HandlerConverter(std::move(model));
+  return std::make_unique<G4HandlerPipeline>([config] { return BuildHandler(config); }, config.pipelineThreads,
+                                             config.pipelineInFlight.value_or(2 * config.pipelineThreads));
 }
@@ -1,8 +1,12 @@
 #pragma once
 
 #include <COLA.hh>
+#include <map>
+#include <memory>
+#include <string>
 
 #include "Deexcitation/G4HandlerConverter.h"
+#include "Deexcitation/G4HandlerPipeline.h"
 
 namespace cola {
 
@@ -12,6 +16,10 @@ namespace cola {
       return DoCreate(params);
     }
 
+    // Event pipeline for drivers that run generator and writer themselves, COLA converters are synchronous.
+    // Handlers are configured by the same parameters, pipelineThreads and pipelineInFlight set its size.
+    static std::unique_ptr<G4HandlerPipeline> CreatePipeline(const std::map<std::string, std::string>& params);
+
   private:
     cola::G4HandlerConverter* DoCreate(const std::map<std::string, std::string>& params);
   };
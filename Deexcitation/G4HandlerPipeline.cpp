@@ -0,0 +1,152 @@
+#include <stdexcept>
+
+#include "Deexcitation/handler/ExcitationHandler.h"
+#include "Deexcitation/handler/HandlerPool.h"
+
+#include "Deexcitation/G4HandlerPipeline.h"
+
+using namespace cola;
+
+G4HandlerPipeline::G4HandlerPipeline(const G4HandlerConverter::HandlerBuilder& builder, size_t threads,
+                                     size_t maxInFlight)
+  : maxInFlight_(maxInFlight) {
+  if (maxInFlight == 0) {
+    throw std::runtime_error("G4HandlerPipeline requires at least one event in flight");
+  }
+
+  pool_ = std::make_unique<HandlerPool>(builder, threads);
+
+  // tasks run until Stop, so every worker takes exactly one of them
+  dispatcher_ = std::thread([this] {
+    try {
+      pool_->Run(pool_->GetSize(), [this](ExcitationHandler& handler, size_t) { ProcessEvents(handler); });
+    } catch (...) {
+      std::lock_guard lock(mutex_);
+      if (!error_) {
+        error_ = std::current_exception();
+      }
+      slotDone_.notify_all();
+    }
+  });
+}
+
+G4HandlerPipeline::~G4HandlerPipeline() {
+  Stop();
+}
+
+void G4HandlerPipeline::Submit(std::unique_ptr<cola::EventData>&& data) {
+  std::unique_lock lock(mutex_);
+  slotFree_.wait(lock, [this] { return slots_.size() < maxInFlight_; });
+
+  pending_.push_back(delivered_ + slots_.size());
+  slots_.push_back(Slot{std::move(data), nullptr, false});
+  jobReady_.notify_one();
+}
+
+std::unique_ptr<cola::EventData> G4HandlerPipeline::Receive() {
+  std::unique_lock lock(mutex_);
+  return ReceiveLocked(lock, true);
+}
+
+std::unique_ptr<cola::EventData> G4HandlerPipeline::TryReceive() {
+  std::unique_lock lock(mutex_);
+  return ReceiveLocked(lock, false);
+}
+
+size_t G4HandlerPipeline::GetInFlight() const {
+  std::lock_guard lock(mutex_);
+  return slots_.size();
+}
+
+void G4HandlerPipeline::Run(cola::VGenerator& generator, cola::VWriter& writer, size_t events) {
+  for (size_t i = 0; i < events; ++i) {
+    // this thread is the only receiver, Submit would wait forever on a full pipeline
+    while (GetInFlight() == maxInFlight_) {
+      writer(Receive());
+    }
+    Submit(generator());
+    while (auto data = TryReceive()) {
+      writer(std::move(data));
+    }
+  }
+
+  while (GetInFlight() != 0) {
+    writer(Receive());
+  }
+}
+
+std::unique_ptr<cola::EventData> G4HandlerPipeline::ReceiveLocked(std::unique_lock<std::mutex>& lock, bool wait) {
+  if (wait) {
+    slotDone_.wait(lock, [this] { return error_ || slots_.empty() || slots_.front().done; });
+  }
+
+  if (!slots_.empty() && slots_.front().done) {
+    // a failed event is delivered as its error, the slot is released either way
+    auto data = std::move(slots_.front().data);
+    auto error = slots_.front().error;
+    slots_.pop_front();
+    ++delivered_;
+    slotFree_.notify_one();
+
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    return data;
+  }
+
+  if (error_) {
+    auto error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+  return nullptr;
+}
+
+void G4HandlerPipeline::ProcessEvents(ExcitationHandler& handler) {
+  G4HandlerConverter converter(handler);
+
+  while (true) {
+    size_t eventIdx;
+    std::unique_ptr<cola::EventData> data;
+    {
+      std::unique_lock lock(mutex_);
+      jobReady_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+      if (stop_) {
+        return;
+      }
+      eventIdx = pending_.front();
+      pending_.pop_front();
+      data = std::move(slots_[eventIdx - delivered_].data);
+    }
+
+    std::exception_ptr error;
+    try {
+      converter.SetNextEventId(eventIdx);
+      data = converter(std::move(data));
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    {
+      std::lock_guard lock(mutex_);
+      // slots before this one aren't delivered until it is done, so the index is still valid
+      auto& slot = slots_[eventIdx - delivered_];
+      slot.data = std::move(data);
+      slot.error = error;
+      slot.done = true;
+      slotDone_.notify_all();
+    }
+  }
+}
+
+void G4HandlerPipeline::Stop() {
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+  }
+  jobReady_.notify_all();
+
+  if (dispatcher_.joinable()) {
+    dispatcher_.join();
+  }
+}
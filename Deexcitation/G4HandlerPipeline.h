@@ -0,0 +1,77 @@
+#pragma once
+
+#include <COLA.hh>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "Deexcitation/handler/ExcitationHandlerFwd.h"
+#include "Deexcitation/G4HandlerConverter.h"
+
+namespace cola {
+  // Event level parallelism: several events are de-excited at once, each worker owns a serial converter.
+  // Events leave in submission order, at most maxInFlight of them are held at a time.
+  class G4HandlerPipeline final {
+  public:
+    G4HandlerPipeline(const G4HandlerConverter::HandlerBuilder& builder, size_t threads, size_t maxInFlight);
+
+    G4HandlerPipeline(const G4HandlerPipeline&) = delete;
+
+    G4HandlerPipeline& operator=(const G4HandlerPipeline&) = delete;
+
+    ~G4HandlerPipeline();
+
+    // blocks while maxInFlight events are already held
+    void Submit(std::unique_ptr<cola::EventData>&& data);
+
+    // next event in submission order, blocks until it is de-excited; nullptr when nothing is in flight,
+    // an event that failed rethrows its error in its turn, later events are still received after it
+    std::unique_ptr<cola::EventData> Receive();
+
+    // next event only if it is already de-excited
+    std::unique_ptr<cola::EventData> TryReceive();
+
+    size_t GetInFlight() const;
+
+    // generator, de-excitation and writer overlap: finished events are written while new ones are generated,
+    // a full pipeline is drained by the writer before the next event is generated
+    void Run(cola::VGenerator& generator, cola::VWriter& writer, size_t events);
+
+  private:
+    struct Slot {
+      std::unique_ptr<cola::EventData> data;
+      std::exception_ptr error;
+      bool done = false;
+    };
+
+    // runs on a pool worker until the pipeline stops, events are converted with the worker's handler
+    void ProcessEvents(ExcitationHandler& handler);
+
+    std::unique_ptr<cola::EventData> ReceiveLocked(std::unique_lock<std::mutex>& lock, bool wait);
+
+    void Stop();
+
+    const size_t maxInFlight_;
+
+    // workers, their engines and handlers come from the pool; the dispatcher keeps one task per worker running
+    std::unique_ptr<HandlerPool> pool_;
+    std::thread dispatcher_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable jobReady_;
+    std::condition_variable slotDone_;
+    std::condition_variable slotFree_;
+
+    // slots_[i] holds event number delivered_ + i
+    std::deque<Slot> slots_;
+    std::deque<size_t> pending_;
+    size_t delivered_ = 0;
+    bool stop_ = false;
+    // the dispatcher failed, no slot will be done anymore
+    std::exception_ptr error_;
+  };
+} // namespace cola
@@ -0,0 +1,26 @@
+#include <cmath>
+
+#include <Randomize.hh>
+
+#include "Conditions.h"
+
+bool DefaultConditions::MultiFragmentation::SampleTransition(const G4Fragment& fragment) const {
+  const auto atomicMass = fragment.GetA_asInt();
+  const auto exitationEnergy = fragment.GetExcitationEnergy();
+
+  const auto scale = 1. / (2. * (upperBoundTransition - lowerBoundTransition));
+  const auto energyOffset = (upperBoundTransition + lowerBoundTransition) / 2.;
+  const auto transitionProb = 0.5 * std::tanh((exitationEnergy / atomicMass - energyOffset) / scale) + 0.5;
+
+  const auto random = G4RandFlat::shoot();
+
+  if (exitationEnergy < lowerBoundTransition * atomicMass) { return false; }
+
+  if (random < transitionProb && exitationEnergy < upperBoundTransition * atomicMass) { return true; }
+
+  if (random > transitionProb && exitationEnergy < upperBoundTransition * atomicMass) { return false; }
+
+  if (exitationEnergy > upperBoundTransition * atomicMass) { return true; }
+
+  return false;
+}
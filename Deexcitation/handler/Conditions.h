@@ -0,0 +1,50 @@
+#pragma once
+
+#include <CLHEP/Units/SystemOfUnits.h>
+
+#include <G4Fragment.hh>
+#include <G4FermiBreakUpAN.hh>
+
+// Default routing conditions of the handler.
+// They are plain functors, so a handler with compile-time conditions inlines them.
+struct DefaultConditions {
+  struct MultiFragmentation {
+    bool operator()(const G4Fragment& fragment) const {
+      if (fragment.GetA_asInt() < maxAtomicMass && fragment.GetZ_asInt() < maxCharge) {
+        return false;
+      }
+      return SampleTransition(fragment);
+    }
+
+    // smooth transition between evaporation and multi-fragmentation in excitation energy per nucleon
+    bool SampleTransition(const G4Fragment& fragment) const;
+
+    G4int maxAtomicMass = 19;
+    G4int maxCharge = 9;
+    G4double lowerBoundTransition = 3 * CLHEP::MeV;
+    G4double upperBoundTransition = 5 * CLHEP::MeV;
+  };
+
+  struct FermiBreakUp {
+    bool operator()(const G4Fragment& fragment) const {
+      return fragment.GetZ_asInt() < maxCharge && fragment.GetA_asInt() < maxAtomicMass;
+    }
+
+    G4int maxAtomicMass = MAX_A;
+    G4int maxCharge = MAX_Z;
+  };
+
+  struct Evaporation {
+    bool operator()(const G4Fragment&) const { return true; }
+  };
+
+  struct PhotonEvaporation {
+    bool operator()(const G4Fragment&) const { return true; }
+  };
+
+  struct NeutronDecay {
+    bool operator()(const G4Fragment& fragment) const {
+      return fragment.GetA_asInt() > 0 && fragment.GetZ_asInt() == 0;
+    }
+  };
+};
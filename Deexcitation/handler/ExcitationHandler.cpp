@@ -2,70 +2,104 @@
 // Created by Artem Novikov on 17.05.2023.
 //
 
+#include <algorithm>
+#include <cmath>
 #include <string>
+#include <utility>
 
 #include <CLHEP/Units/PhysicalConstants.h>
 
-#include <G4BosonConstructor.hh>
-#include <G4LeptonConstructor.hh>
-#include <G4MesonConstructor.hh>
-#include <G4BaryonConstructor.hh>
-#include <G4IonConstructor.hh>
-#include <G4ProcessManager.hh>
-#include <G4StateManager.hh>
 #include <G4RunManager.hh>
 
 #include <G4LorentzVector.hh>
-#include <G4NistManager.hh>
 #include <G4ParticleTable.hh>
 #include <G4ParticleTypes.hh>
 #include <G4Ions.hh>
 #include <G4Electron.hh>
 
 #include <G4Evaporation.hh>
+#include <G4NuclearLevelData.hh>
+#include <G4NucleiProperties.hh>
 #include <G4FermiBreakUpAN.hh>
 #include <G4PhotonEvaporation.hh>
 #include <G4StatMF.hh>
 
+#include "HandlerPool.h"
+
 #include "ExcitationHandler.h"
 
 namespace {
   constexpr size_t EvaporationIterationThreshold = 1e3;
 
+  // excitation energies per nucleon 1..WarmUpTrials MeV, covers evaporation and multi-fragmentation
+  constexpr size_t WarmUpTrials = 6;
+
   static const std::string ErrorNoModel = "no model was applied, check conditions";
 
+  // heaviest stable nuclide of the range, otherwise the heaviest one closest to the valley of stability,
+  // {0, 0} for an empty range
+  std::pair<G4int, G4int> WarmUpNuclide(const NuclideRange& range) {
+    const auto& stability = StabilityTable::Instance();
+    for (auto A = range.maxA; A >= std::max(range.minA, 1); --A) {
+      for (auto Z = std::min(range.maxZ, A); Z >= range.minZ; --Z) {
+        if (stability.IsStable(Z, A)) {
+          return {A, Z};
+        }
+      }
+    }
+
+    for (auto A = range.maxA; A >= std::max(range.minA, 1); --A) {
+      // Z of the valley of stability from the liquid drop model
+      const auto valleyZ = static_cast<G4int>(std::lround(A / (1.98 + 0.0155 * std::pow(A, 2. / 3.))));
+      const auto maxZ = std::min(range.maxZ, A);
+      if (range.minZ <= maxZ) {
+        return {A, std::clamp(valleyZ, range.minZ, maxZ)};
+      }
+    }
+    return {0, 0};
+  }
+
   class FermiBreakUpWrapper : public G4FermiBreakUpAN {
   public:
     using G4FermiBreakUpAN::G4FermiBreakUpAN;
 
     void BreakFragment(G4FragmentVector* results, G4Fragment* theNucleus) override {
-      auto deletableFragment = new G4Fragment(*theNucleus);
+      auto deletableFragment = arena_ != nullptr ? arena_->Create(*theNucleus) : new G4Fragment(*theNucleus);
       auto oldSize = results->size();
       G4FermiBreakUpAN::BreakFragment(results, deletableFragment);
       if (oldSize == results->size()) {
-        delete deletableFragment;
+        FragmentArena::Deleter(arena_)(deletableFragment);
       }
     }
+
+    void SetArena(FragmentArena* arena) { arena_ = arena; }
+
+  private:
+    FragmentArena* arena_ = nullptr;
   };
 
-  class DataCleaner {
+  void ClearResults(G4FragmentVector& results, FragmentArena& arena) {
+    for (auto ptr : results) {
+      arena.Destroy(ptr);
+    }
+    results.clear();
+  }
+
+  template <class F>
+  class ScopeExit {
   public:
-    DataCleaner(G4FragmentVector& results) : results_ (results) {}
+    ScopeExit(F&& f) : f_(std::move(f)) {}
 
-    ~DataCleaner() {
-      for (auto ptr : results_) {
-        delete ptr;
-      }
-    }
+    ~ScopeExit() { f_(); }
 
   private:
-    G4FragmentVector& results_;
+    F f_;
   };
 
-  void ClearSingularResults(G4FragmentVector& results, G4Fragment* initial) {
+  void ClearSingularResults(G4FragmentVector& results, G4Fragment* initial, FragmentArena& arena) {
     for (auto fragmentPtr : results) {
       if (fragmentPtr != initial) {
-        delete fragmentPtr;
+        arena.Destroy(fragmentPtr);
       }
     }
   }
@@ -122,6 +156,24 @@ namespace {
     return nullptr;
   }
 
+  void FillProduct(G4ReactionProduct& product, const G4Fragment& fragment) {
+    product.SetMomentum(fragment.GetMomentum().vect());
+    product.SetTotalEnergy(fragment.GetMomentum().e());
+    product.SetFormationTime(fragment.GetCreationTime());
+  }
+
+  // keeps the energy and direction, momentum modulus is recomputed for the given mass
+  void PutOnMassShell(G4Fragment& fragment, G4double mass) {
+    if (fragment.GetMomentum().e() <= mass) {
+      fragment.SetMomentum(G4LorentzVector(mass));
+    } else {
+      auto momentum = fragment.GetMomentum();
+      G4double momentumModulus = std::sqrt((momentum.e() - mass) * (momentum.e() + mass));
+      momentum.setVect(momentum.vect().unit() * momentumModulus);
+      fragment.SetMomentum(momentum);
+    }
+  }
+
   void EvaporationError(const G4Fragment& fragment, const G4Fragment& currentFragment, size_t iter) {
     G4ExceptionDescription ed;
     ed << "Infinite loop in the de-excitation module: " << iter
@@ -133,7 +185,12 @@ namespace {
   }
 } // namespace
 
-ExcitationHandler::ExcitationHandler()
+template <class Traits>
+BasicExcitationHandler<Traits>::BasicExcitationHandler(IonTableMode ionTableMode)
+  : BasicExcitationHandler(ionTableMode, Clock::now()) {}
+
+template <class Traits>
+BasicExcitationHandler<Traits>::BasicExcitationHandler(IonTableMode ionTableMode, Clock::time_point startTime)
   : multiFragmentationModel_(DefaultMultiFragmentation())
   , fermiBreakUpModel_(DefaultFermiBreakUp())
   , evaporationModel_(DefaultEvaporation())
@@ -144,355 +201,714 @@ ExcitationHandler::ExcitationHandler()
   , photonEvaporationCondition_(DefaultPhotonEvaporationCondition())
   , evaporationCondition_(DefaultEvaporationCondition())
   , neutronDecayCondition_(DefaultNeutronDecayCondition())
+  , ionTableMode_(ionTableMode)
+  , arena_(std::make_unique<FragmentArena>())
 {
+  BindFermiBreakUpArena();
   evaporationModel_->SetFermiBreakUp(fermiBreakUpModel_.get());
   evaporationModel_->SetPhotonEvaporation(photonEvaporationModel_.get());
 
-  G4BosonConstructor pCBos;
-  pCBos.ConstructParticle();
+  ParticleEnvironment::Initialize(ionTableMode_);
 
-  G4LeptonConstructor pCLept;
-  pCLept.ConstructParticle();
+  startupTime_ = Clock::now() - startTime;
+}
 
-  G4MesonConstructor pCMes;
-  pCMes.ConstructParticle();
+template <class Traits>
+std::chrono::duration<double> BasicExcitationHandler<Traits>::WarmUp(const NuclideRange& range) {
+  const auto startTime = Clock::now();
+
+  fermiBreakUpModel_->Initialise();
+  evaporationModel_->InitialiseChannels();
+  photonEvaporationModel_->Initialise();
+
+  const auto minZ = std::max(range.minZ, 1);
+  const auto maxZ = std::min(range.maxZ, NuclideChart::MaxZ);
+  const auto maxA = std::min(range.maxA, NuclideChart::MaxA);
+  auto levelData = G4NuclearLevelData::GetInstance();
+  for (auto Z = minZ; Z <= maxZ; ++Z) {
+    for (auto A = std::max(range.minA, Z); A <= maxA; ++A) {
+      levelData->GetLevelManager(Z, A);
+    }
+  }
+  ionCache_.Prewarm(range);
+
+  // trial breakups of the heaviest nuclide of the range touch lazily built tables of every stage
+  const auto [trialA, trialZ] = WarmUpNuclide(NuclideRange{minZ, maxZ, range.minA, maxA});
+  if (trialZ >= 1 && trialA >= 2) {
+    const auto savedStats = stats_;
+    const auto savedFallbacks = fallbackCount_;
+    const auto savedIonHits = ionCache_.GetHits();
+    const auto savedIonMisses = ionCache_.GetMisses();
+    const auto savedEventId = streamEventId_;
+    const auto savedFragmentIdx = streamFragmentIdx_;
+
+    auto trialStream = RandomStream(0);
+    std::vector<G4ReactionProduct> products;
+    for (size_t trial = 0; trial < WarmUpTrials; ++trial) {
+      const auto stream = trialStream.Enter(0, trial);
+      const auto energy = (trial + 1) * CLHEP::MeV * trialA;
+      products.clear();
+      BreakItUp(G4Fragment(trialA, trialZ, G4LorentzVector(0, 0, 0, G4NucleiProperties::GetNuclearMass(trialA, trialZ) + energy)),
+                products);
+    }
 
-  G4BaryonConstructor pCBar;
-  pCBar.ConstructParticle();
+    stats_ = savedStats;
+    fallbackCount_ = savedFallbacks;
+    ionCache_.RestoreCounters(savedIonHits, savedIonMisses);
+    streamEventId_ = savedEventId;
+    streamFragmentIdx_ = savedFragmentIdx;
+  }
 
-  G4IonConstructor pCIon;
-  pCIon.ConstructParticle();
+  const auto elapsed = std::chrono::duration<double>(Clock::now() - startTime);
+  warmUpTime_ += elapsed;
+  return elapsed;
+}
 
-  G4GenericIon* gion = G4GenericIon::GenericIon();
-  auto manager = new G4ProcessManager(gion);
-  manager->SetVerboseLevel(0);
-  gion->SetProcessManager(manager);
+template <class Traits>
+BasicExcitationHandler<Traits>::~BasicExcitationHandler() {
+  photonEvaporationModel_.release();  // otherwise, SegFault in evaporation destructor
+}
 
-  G4StateManager::GetStateManager()->SetNewState(G4State_Init); // To let create ions
-  G4ParticleTable* particleTable = G4ParticleTable::GetParticleTable();
-  G4IonTable* ionTable = particleTable->GetIonTable();
-  particleTable->SetReadiness();
-  ionTable->CreateAllIon();
-  ionTable->CreateAllIsomer();
+template <class Traits>
+BasicExcitationHandler<Traits>& BasicExcitationHandler<Traits>::SetWorkBudget(const WorkBudget& budget) {
+  if (budget.maxIterations == 0 && budget.maxTime.count() <= 0) {
+    throw std::runtime_error("work budget must limit iterations or time");
+  }
+  budget_ = budget;
+  return *this;
 }
 
-ExcitationHandler::~ExcitationHandler() {
-  photonEvaporationModel_.release();  // otherwise, SegFault in evaporation destructor
+template <class Traits>
+std::vector<G4ReactionProduct> BasicExcitationHandler<Traits>::BreakItUp(const G4Fragment& fragment) {
+  std::vector<G4ReactionProduct> reactionProducts;
+  BreakItUp(fragment, reactionProducts);
+
+  return reactionProducts;
 }
 
-std::vector<G4ReactionProduct> ExcitationHandler::BreakItUp(const G4Fragment& fragment) {
-  auto nist = G4NistManager::Instance();
-  G4FragmentVector results;
-  const auto cleaner = DataCleaner(results);
-  FragmentQueue evaporationQueue;
-  FragmentQueue photonEvaporationQueue;
+template <class Traits>
+void BasicExcitationHandler<Traits>::BreakItUp(const G4Fragment& fragment, std::vector<G4ReactionProduct>& products) {
+  const auto cleaner = ScopeExit([this] { ClearScratch(); });
 
-  // In case A <= 1 the fragment will not perform any nucleon emission
-  auto initialFragmentPtr = std::make_unique<G4Fragment>(fragment);
-  if (neutronDecayCondition_(fragment)) {
-    ApplyPureNeutronDecay(std::move(initialFragmentPtr), results);
-  } else if (IsStable(fragment, nist)) {
-    results.push_back(initialFragmentPtr.release());
-  } else {
-    if (multiFragmentationCondition_(fragment)) {
-      ApplyMultiFragmentation(std::move(initialFragmentPtr), results, evaporationQueue);
-    } else {
-      evaporationQueue.emplace(std::move(initialFragmentPtr));
-    }
+  Deexcite(fragment);
 
-    for (size_t iterationCount = 0; !evaporationQueue.empty(); ++iterationCount) {
-      auto fragmentPtr = std::move(evaporationQueue.front());
-      evaporationQueue.pop();
+  ConvertResults(results_, products);
+}
 
-      // infinite loop check
-      if (iterationCount == EvaporationIterationThreshold) {
-        EvaporationError(fragment, *fragmentPtr, iterationCount);
-        return {};
-        // process is dead
-      }
+template <class Traits>
+void BasicExcitationHandler<Traits>::BreakItUp(const G4Fragment& fragment, const ProductSink& sink) {
+  const auto cleaner = ScopeExit([this] { ClearScratch(); });
 
-      // NeutronDecay part
-      if (neutronDecayCondition_(*fragmentPtr)) {
-        ApplyPureNeutronDecay(std::move(fragmentPtr), results);
-        continue;
-      }
+  Deexcite(fragment);
 
-      // FermiBreakUp part
-      if (fermiCondition_(*fragmentPtr)) {
-        ApplyFermiBreakUp(std::move(fragmentPtr), results, photonEvaporationQueue);
-        continue;
-      }
+  ConvertResults(results_, sink);
+}
 
-      // Evaporation part
-      if (evaporationCondition_(*fragmentPtr)) {
-        ApplyEvaporation(std::move(fragmentPtr), results, evaporationQueue);
-        continue;
-      }
+template <class Traits>
+void BasicExcitationHandler<Traits>::BreakItUpFragments(const G4Fragment& fragment, const FragmentSink& sink) {
+  const auto cleaner = ScopeExit([this] { ClearScratch(); });
 
-      throw std::runtime_error(ErrorNoModel);
-    }
+  Deexcite(fragment);
+  for (const auto& fragmentPtr : results_) {
+    PrepareFinalFragment(*fragmentPtr);
+    sink(*fragmentPtr);
+  }
+}
 
-    // Photon Evaporation part
-    while (!photonEvaporationQueue.empty()) {
-      auto fragmentPtr = std::move(photonEvaporationQueue.front());
-      photonEvaporationQueue.pop();
+template <class Traits>
+void BasicExcitationHandler<Traits>::EvaporateFragment(const G4Fragment& fragment, const FragmentSink& sink) {
+  const auto cleaner = ScopeExit([this] { ClearScratch(); });
 
-      if (photonEvaporationCondition_(*fragmentPtr)) {
-        ApplyPhotonEvaporation(std::move(fragmentPtr), results);
-        continue;
-      }
+  evaporationQueue_.Push(MakeFragment(fragment));
+  if (randomStream_ == nullptr) {
+    RunEvaporationStages(fragment);
+  } else {
+    const auto stream = randomStream_->Enter(streamEventId_, streamFragmentIdx_++);
+    RunEvaporationStages(fragment);
+  }
 
-      throw std::runtime_error(ErrorNoModel);
-    }
+  for (const auto& fragmentPtr : results_) {
+    sink(*fragmentPtr);
   }
+}
 
-  auto reactionProducts = ConvertResults(results);
+template <class Traits>
+void BasicExcitationHandler<Traits>::PrepareFinalFragment(G4Fragment& fragment) {
+  // only a lookup miss changes the fragment
+  ResolveDefinition(fragment);
+}
 
-  return reactionProducts;
+template <class Traits>
+template <class F>
+void BasicExcitationHandler<Traits>::RunStagedStep(size_t fragmentIdx, F&& step) {
+  // time budget counts only the steps of the input itself, not the whole batch
+  const auto timed = budget_.has_value() && budget_->maxTime.count() != 0;
+  const auto startTime = timed ? Clock::now() : Clock::time_point();
+  if (randomStream_ == nullptr) {
+    step();
+  } else {
+    const auto streamIdx = ((streamFragmentIdx_ + fragmentIdx) << 32) | stagedSteps_[fragmentIdx]++;
+    const auto stream = randomStream_->Enter(streamEventId_, streamIdx);
+    step();
+  }
+  if (timed) {
+    stagedElapsed_[fragmentIdx] += Clock::now() - startTime;
+  }
+  resultOrigins_.resize(results_.size(), fragmentIdx);
 }
 
-void ExcitationHandler::NeutronDecay::BreakFragment(G4FragmentVector& results, const G4Fragment& fragment) {
-  if (fragment.GetZ_asInt() != 0) {
-    throw std::runtime_error("only Z = 0 particles can be decayed by NeutronDecay, but got: A = " 
-      + std::to_string(fragment.GetA_asInt()) + ", Z = " + std::to_string(fragment.GetZ_asInt()));
+template <class Traits>
+bool BasicExcitationHandler<Traits>::IsStagedBudgetExhausted(size_t fragmentIdx) {
+  if (!stagedExhausted_[fragmentIdx]) {
+    stagedExhausted_[fragmentIdx] =
+        (budget_->maxIterations != 0 && stagedIterations_[fragmentIdx] >= budget_->maxIterations)
+        || (budget_->maxTime.count() != 0 && stagedElapsed_[fragmentIdx] >= budget_->maxTime);
   }
+  return stagedExhausted_[fragmentIdx];
+}
 
-  if (fragment.GetA_asInt() == 1) {
-    return;
+template <class Traits>
+void BasicExcitationHandler<Traits>::BreakItUpStaged(const std::vector<G4Fragment>& fragments,
+                                                     const IndexedFragmentSink& sink) {
+  const auto cleaner = ScopeExit([this] {
+    ClearStaged();
+    ClearScratch();
+  });
+
+  stagedSteps_.assign(fragments.size(), 0);
+  stagedIterations_.assign(fragments.size(), 0);
+  stagedElapsed_.assign(fragments.size(), std::chrono::nanoseconds(0));
+  stagedExhausted_.assign(fragments.size(), false);
+
+  const auto drain = [](FragmentQueue& queue, StagedWork& work, size_t fragmentIdx) {
+    while (!queue.Empty()) {
+      work.emplace_back(queue.Pop(), fragmentIdx);
+    }
+  };
+
+  // routing of the inputs, like the beginning of RunStages
+  for (size_t idx = 0; idx < fragments.size(); ++idx) {
+    RunStagedStep(idx, [this, &fragments, idx] {
+      const auto& fragment = fragments[idx];
+      auto fragmentPtr = MakeFragment(fragment);
+      if (neutronDecayCondition_(fragment)) {
+        ApplyPureNeutronDecay(std::move(fragmentPtr), results_);
+      } else if (IsStable(fragment)) {
+        results_.push_back(fragmentPtr.release());
+      } else if (multiFragmentationCondition_(fragment)) {
+        stagedMultiFragmentation_.emplace_back(std::move(fragmentPtr), idx);
+      } else {
+        stagedRouting_.emplace_back(std::move(fragmentPtr), idx);
+      }
+    });
+  }
+
+  // MultiFragmentation stage
+  for (auto& [fragment, idx] : stagedMultiFragmentation_) {
+    RunStagedStep(idx, [this, &drain, &fragmentPtr = fragment, idx = idx] {
+      ApplyMultiFragmentation(std::move(fragmentPtr), results_, evaporationQueue_);
+      drain(evaporationQueue_, stagedRouting_, idx);
+    });
+  }
+  stagedMultiFragmentation_.clear();
+
+  // FermiBreakUp and Evaporation stages, a round per evaporation step of the whole batch:
+  // pending fragments are routed to the stage lists and then every list is drained on its own
+  while (!stagedRouting_.empty()) {
+    // a routed fragment is an iteration of its input, like a pop of the evaporation queue in RunStages
+    for (auto& [fragment, idx] : stagedRouting_) {
+      auto& fragmentPtr = fragment;
+      if (budget_.has_value() && IsStagedBudgetExhausted(idx)) {
+        RunStagedStep(idx, [this, &fragmentPtr] { ApplyFallback(std::move(fragmentPtr), results_); });
+        continue;
+      }
+      if (stagedIterations_[idx] == EvaporationIterationThreshold) {
+        // infinite loop check
+        EvaporationError(fragments[idx], *fragmentPtr, stagedIterations_[idx]);
+        // process is dead
+        return;
+      }
+      ++stagedIterations_[idx];
+
+      if (neutronDecayCondition_(*fragmentPtr)) {
+        stagedNeutronDecay_.emplace_back(std::move(fragmentPtr), idx);
+      } else if (fermiCondition_(*fragmentPtr)) {
+        stagedFermiBreakUp_.emplace_back(std::move(fragmentPtr), idx);
+      } else if (evaporationCondition_(*fragmentPtr)) {
+        stagedEvaporation_.emplace_back(std::move(fragmentPtr), idx);
+      } else if (budget_.has_value()) {
+        RunStagedStep(idx, [this, &fragmentPtr] { ApplyFallback(std::move(fragmentPtr), results_); });
+      } else {
+        throw std::runtime_error(ErrorNoModel);
+      }
+    }
+    stagedRouting_.clear();
+
+    // PureNeutronDecay stage
+    for (auto& [fragment, idx] : stagedNeutronDecay_) {
+      RunStagedStep(idx, [this, &fragmentPtr = fragment] { ApplyPureNeutronDecay(std::move(fragmentPtr), results_); });
+    }
+    stagedNeutronDecay_.clear();
+
+    // FermiBreakUp stage
+    for (auto& [fragment, idx] : stagedFermiBreakUp_) {
+      RunStagedStep(idx, [this, &drain, &fragmentPtr = fragment, idx = idx] {
+        ApplyFermiBreakUp(std::move(fragmentPtr), results_, photonEvaporationQueue_);
+        drain(photonEvaporationQueue_, stagedPhotonEvaporation_, idx);
+      });
+    }
+    stagedFermiBreakUp_.clear();
+
+    // Evaporation stage, residuals are routed in the next round
+    for (auto& [fragment, idx] : stagedEvaporation_) {
+      RunStagedStep(idx, [this, &drain, &fragmentPtr = fragment, idx = idx] {
+        ApplyEvaporation(std::move(fragmentPtr), results_, evaporationQueue_);
+        drain(evaporationQueue_, stagedRouting_, idx);
+      });
+    }
+    stagedEvaporation_.clear();
   }
 
-  auto masses = std::vector<G4double>(fragment.GetA_asInt(), CLHEP::neutron_mass_c2);
-  auto momentum = fragment.GetMomentum();
-  if (const auto diff = momentum.m() - CLHEP::neutron_mass_c2 * fragment.GetA_asInt(); diff < 10. * CLHEP::eV) {
-    momentum.setE(momentum.e() + 10. * CLHEP::eV - diff);
+  if (statsEnabled_) {
+    for (const auto iterations : stagedIterations_) {
+      stats_.RecordIterations(iterations);
+    }
   }
 
-  const auto particlesMomentum = phaseSpaceDecay_.CalculateDecay(momentum, masses);
-  if (particlesMomentum.size() == 0) {
-    std::stringstream ss;
-    ss << "NeutronDecay is unable to break particle with "
-     << "A = " << fragment.GetA_asInt()
-     << ", Z = " << fragment.GetZ_asInt()
-     << ", P = " << momentum
-    ;
-    throw std::runtime_error(ss.str());
+  // Photon Evaporation stage
+  for (auto& [fragment, idx] : stagedPhotonEvaporation_) {
+    RunStagedStep(idx, [this, &fragmentPtr = fragment, idx = idx] {
+      if (!stagedExhausted_[idx] && photonEvaporationCondition_(*fragmentPtr)) {
+        ApplyPhotonEvaporation(std::move(fragmentPtr), results_);
+      } else if (budget_.has_value()) {
+        ApplyFallback(std::move(fragmentPtr), results_);
+      } else {
+        throw std::runtime_error(ErrorNoModel);
+      }
+    });
   }
+  stagedPhotonEvaporation_.clear();
 
-  for (const auto& momentum : particlesMomentum) {
-    results.emplace_back(new G4Fragment(1, 0, momentum));
+  // counting sort of the results by input, order inside an input is kept
+  stagedOffsets_.assign(fragments.size() + 1, 0);
+  for (const auto idx : resultOrigins_) {
+    ++stagedOffsets_[idx + 1];
+  }
+  for (size_t idx = 0; idx < fragments.size(); ++idx) {
+    stagedOffsets_[idx + 1] += stagedOffsets_[idx];
+  }
+  stagedOrder_.resize(results_.size());
+  for (size_t resultIdx = 0; resultIdx < results_.size(); ++resultIdx) {
+    stagedOrder_[stagedOffsets_[resultOrigins_[resultIdx]]++] = resultIdx;
   }
+
+  for (const auto resultIdx : stagedOrder_) {
+    auto& fragment = *results_[resultIdx];
+    PrepareFinalFragment(fragment);
+    sink(resultOrigins_[resultIdx], fragment);
+  }
+
+  streamFragmentIdx_ += fragments.size();
 }
 
-std::unique_ptr<G4VMultiFragmentation> ExcitationHandler::DefaultMultiFragmentation() {
-  return std::make_unique<G4StatMF>();
+template <class Traits>
+void BasicExcitationHandler<Traits>::ClearStaged() {
+  stagedMultiFragmentation_.clear();
+  stagedRouting_.clear();
+  stagedNeutronDecay_.clear();
+  stagedFermiBreakUp_.clear();
+  stagedEvaporation_.clear();
+  stagedPhotonEvaporation_.clear();
+  resultOrigins_.clear();
+  stagedOrder_.clear();
 }
 
-std::unique_ptr<G4VFermiBreakUp> ExcitationHandler::DefaultFermiBreakUp() {
-  auto model = std::make_unique<FermiBreakUpWrapper>();
-  model->Initialise();
-  return model;
+template <class Traits>
+void BasicExcitationHandler<Traits>::BreakItUp(const G4Fragment& fragment, ProductColumns& products) {
+  const auto cleaner = ScopeExit([this] { ClearScratch(); });
+
+  Deexcite(fragment);
+  ConvertResults(results_, products);
 }
 
-std::unique_ptr<G4VEvaporation> ExcitationHandler::DefaultEvaporation() {
-  auto evaporation = std::make_unique<G4Evaporation>();
-  return evaporation;
+template <class Traits>
+void BasicExcitationHandler<Traits>::BreakItUp(const G4Fragment& fragment, ProductColumnsF& products) {
+  const auto cleaner = ScopeExit([this] { ClearScratch(); });
+
+  Deexcite(fragment);
+  ConvertResults(results_, products);
 }
 
-std::unique_ptr<G4VEvaporationChannel> ExcitationHandler::DefaultPhotonEvaporation() {
-  return std::make_unique<G4PhotonEvaporation>();
+template <class Traits>
+void BasicExcitationHandler<Traits>::BreakItUp(const std::vector<G4Fragment>& fragments, BatchResult& output) {
+  const auto cleaner = ScopeExit([this] { ClearScratch(); });
+
+  output.products.clear();
+  output.offsets.clear();
+  output.offsets.reserve(fragments.size() + 1);
+  output.offsets.push_back(0);
+
+  for (const auto& fragment : fragments) {
+    Deexcite(fragment);
+    ConvertResults(results_, output.products);
+    ClearScratch();
+    output.offsets.push_back(output.products.size());
+  }
 }
 
-std::unique_ptr<ExcitationHandler::NeutronDecay> ExcitationHandler::DefaultNeutronDecay() {
-  return std::make_unique<NeutronDecay>();
+template <class Traits>
+void BasicExcitationHandler<Traits>::Deexcite(const G4Fragment& fragment) {
+  if (randomStream_ == nullptr) {
+    RunStages(fragment);
+    return;
+  }
+
+  const auto stream = randomStream_->Enter(streamEventId_, streamFragmentIdx_++);
+  RunStages(fragment);
+}
+
+template <class Traits>
+void BasicExcitationHandler<Traits>::RunStages(const G4Fragment& fragment) {
+  // In case A <= 1 the fragment will not perform any nucleon emission
+  auto initialFragmentPtr = MakeFragment(fragment);
+  if (neutronDecayCondition_(fragment)) {
+    ApplyPureNeutronDecay(std::move(initialFragmentPtr), results_);
+  } else if (IsStable(fragment)) {
+    results_.push_back(initialFragmentPtr.release());
+  } else {
+    if (multiFragmentationCondition_(fragment)) {
+      ApplyMultiFragmentation(std::move(initialFragmentPtr), results_, evaporationQueue_);
+      if (parallelPool_ != nullptr && evaporationQueue_.Size() >= parallelThreshold_) {
+        EvaporateInParallel();
+        return;
+      }
+    } else {
+      evaporationQueue_.Push(std::move(initialFragmentPtr));
+    }
+
+    RunEvaporationStages(fragment);
+  }
 }
 
-ExcitationHandler::Condition ExcitationHandler::DefaultMultiFragmentationCondition() {
-  return [](const G4Fragment& fragment) -> bool {
-    constexpr G4int maxAtomicMass = 19;
-    constexpr G4int maxCharge = 9;
-    constexpr G4double lowerBoundTransitionMF = 3 * CLHEP::MeV;
-    constexpr G4double upperBoundTransitionMF = 5 * CLHEP::MeV;
+template <class Traits>
+void BasicExcitationHandler<Traits>::RunEvaporationStages(const G4Fragment& fragment) {
+  const auto timed = budget_.has_value() && budget_->maxTime.count() != 0;
+  const auto startTime = timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+  bool budgetExhausted = false;
+
+  size_t iterationCount = 0;
+  for (; !evaporationQueue_.Empty(); ++iterationCount) {
+    if (statsEnabled_) {
+      stats_.evaporationQueueHighWater = std::max(stats_.evaporationQueueHighWater, evaporationQueue_.Size());
+    }
+    auto fragmentPtr = evaporationQueue_.Pop();
+
+    if (budget_.has_value()) {
+      budgetExhausted = budgetExhausted
+                        || (budget_->maxIterations != 0 && iterationCount >= budget_->maxIterations)
+                        || (timed && std::chrono::steady_clock::now() - startTime >= budget_->maxTime);
+      if (budgetExhausted) {
+        ApplyFallback(std::move(fragmentPtr), results_);
+        continue;
+      }
+    }
+    if (iterationCount == EvaporationIterationThreshold) {
+      // infinite loop check
+      EvaporationError(fragment, *fragmentPtr, iterationCount);
+      // process is dead
+      fragmentPtr.reset();
+      ClearScratch();
+      return;
+    }
 
-    const auto atomicMass = fragment.GetA_asInt();
-    const auto charge = fragment.GetZ_asInt();
+    // NeutronDecay part
+    if (neutronDecayCondition_(*fragmentPtr)) {
+      ApplyPureNeutronDecay(std::move(fragmentPtr), results_);
+      continue;
+    }
 
-    if (atomicMass < maxAtomicMass && charge < maxCharge) { return false; }
+    // FermiBreakUp part
+    if (fermiCondition_(*fragmentPtr)) {
+      ApplyFermiBreakUp(std::move(fragmentPtr), results_, photonEvaporationQueue_);
+      continue;
+    }
 
-    const auto exitationEnergy = fragment.GetExcitationEnergy();
+    // Evaporation part
+    if (evaporationCondition_(*fragmentPtr)) {
+      ApplyEvaporation(std::move(fragmentPtr), results_, evaporationQueue_);
+      continue;
+    }
 
-    const auto scale = 1. / (2. * (upperBoundTransitionMF - lowerBoundTransitionMF));
-    const auto energyOffset = (upperBoundTransitionMF + lowerBoundTransitionMF) / 2.;
-    const auto transitionProb = 0.5 * std::tanh((exitationEnergy / atomicMass - energyOffset) / scale) + 0.5;
+    if (budget_.has_value()) {
+      ApplyFallback(std::move(fragmentPtr), results_);
+      continue;
+    }
 
-    const auto random = G4RandFlat::shoot();
+    throw std::runtime_error(ErrorNoModel);
+  }
 
-    if (exitationEnergy < lowerBoundTransitionMF * atomicMass) { return false; }
+  if (statsEnabled_) {
+    stats_.RecordIterations(iterationCount);
+    stats_.photonEvaporationQueueHighWater = std::max(stats_.photonEvaporationQueueHighWater,
+                                                      photonEvaporationQueue_.Size());
+  }
 
-    if (random < transitionProb && exitationEnergy < upperBoundTransitionMF * atomicMass) { return true; }
+  // Photon Evaporation part
+  while (!photonEvaporationQueue_.Empty()) {
+    auto fragmentPtr = photonEvaporationQueue_.Pop();
 
-    if (random > transitionProb && exitationEnergy < upperBoundTransitionMF * atomicMass) { return false; }
+    if (!budgetExhausted && photonEvaporationCondition_(*fragmentPtr)) {
+      ApplyPhotonEvaporation(std::move(fragmentPtr), results_);
+      continue;
+    }
 
-    if (exitationEnergy > upperBoundTransitionMF * atomicMass) { return true; }
+    if (budget_.has_value()) {
+      ApplyFallback(std::move(fragmentPtr), results_);
+      continue;
+    }
 
-    return false;
-  };
+    throw std::runtime_error(ErrorNoModel);
+  }
 }
 
-ExcitationHandler::Condition ExcitationHandler::DefaultFermiBreakUpCondition() {
-  return [](const G4Fragment& fragment) -> bool {
-    return fragment.GetZ_asInt() < MAX_Z && fragment.GetA_asInt() < MAX_A;
-  };
+template <class Traits>
+void BasicExcitationHandler<Traits>::EvaporateInParallel() {
+  parallelFragments_.clear();
+  while (!evaporationQueue_.Empty()) {
+    parallelFragments_.emplace_back(*evaporationQueue_.Pop());
+  }
+  parallelProducts_.resize(std::max(parallelProducts_.size(), parallelFragments_.size()));
+
+  // streams of the products are derived from the stream of the fragment entered in Deexcite
+  const auto streamIdx = randomStream_ != nullptr
+                         ? (std::uint64_t(1) << 63) | ((streamFragmentIdx_ - 1) << 32) : std::uint64_t(0);
+  parallelPool_->Run(parallelFragments_.size(), [this, streamIdx](ExcitationHandler& handler, size_t taskIdx) {
+    auto& products = parallelProducts_[taskIdx];
+    products.clear();
+    if (randomStream_ != nullptr) {
+      handler.SetStreamPosition(streamEventId_, streamIdx | taskIdx);
+    }
+    handler.EvaporateFragment(parallelFragments_[taskIdx], [&products](const G4Fragment& product) {
+      products.push_back(product);
+    });
+  });
+
+  for (size_t taskIdx = 0; taskIdx < parallelFragments_.size(); ++taskIdx) {
+    for (const auto& product : parallelProducts_[taskIdx]) {
+      results_.push_back(MakeFragment(product).release());
+    }
+  }
+}
+
+template <class Traits>
+void BasicExcitationHandler<Traits>::ClearScratch() {
+  evaporationQueue_.Clear();
+  photonEvaporationQueue_.Clear();
+  ClearResults(stageFragments_, *arena_);
+  ClearResults(results_, *arena_);
+  arena_->Reset();
 }
 
-ExcitationHandler::Condition ExcitationHandler::DefaultEvaporationCondition() {
-  return [](const G4Fragment&) { return true; };
+template <class Traits>
+std::unique_ptr<typename Traits::MultiFragmentationModel> BasicExcitationHandler<Traits>::DefaultMultiFragmentation() {
+  return std::make_unique<G4StatMF>();
 }
 
-ExcitationHandler::Condition ExcitationHandler::DefaultPhotonEvaporationCondition() {
-  return [](const G4Fragment&) { return true; };
+template <class Traits>
+std::unique_ptr<typename Traits::FermiBreakUpModel> BasicExcitationHandler<Traits>::DefaultFermiBreakUp() {
+  auto model = std::make_unique<FermiBreakUpWrapper>();
+  model->Initialise();
+  return model;
 }
 
-ExcitationHandler::Condition ExcitationHandler::DefaultNeutronDecayCondition() {
-  return [](const G4Fragment& fragment) {
-    return fragment.GetA_asInt() > 0 && fragment.GetZ_asInt() == 0;
-  };
+template <class Traits>
+std::unique_ptr<typename Traits::EvaporationModel> BasicExcitationHandler<Traits>::DefaultEvaporation() {
+  auto evaporation = std::make_unique<G4Evaporation>();
+  return evaporation;
+}
+
+template <class Traits>
+std::unique_ptr<typename Traits::PhotonEvaporationModel> BasicExcitationHandler<Traits>::DefaultPhotonEvaporation() {
+  return std::make_unique<G4PhotonEvaporation>();
 }
 
-bool ExcitationHandler::IsGroundState(const G4Fragment& fragment) const {
-  return fragment.GetExcitationEnergy() < stableThreshold_;
+template <class Traits>
+std::unique_ptr<typename Traits::NeutronDecayModel> BasicExcitationHandler<Traits>::DefaultNeutronDecay() {
+  return std::make_unique<NeutronDecay>();
 }
 
-bool ExcitationHandler::IsStable(const G4Fragment& fragment, const G4NistManager* nist) const {
-  return fragment.GetA_asInt() <= 1
-         || (IsGroundState(fragment)
-             && nist->GetIsotopeAbundance(fragment.GetZ_asInt(), fragment.GetA_asInt()) > 0);
+template <class Traits>
+void BasicExcitationHandler<Traits>::BindFermiBreakUpArena() {
+  if (auto wrapper = dynamic_cast<FermiBreakUpWrapper*>(fermiBreakUpModel_.get())) {
+    wrapper->SetArena(arena_.get());
+  }
 }
 
-void ExcitationHandler::ApplyMultiFragmentation(std::unique_ptr<G4Fragment>&& fragment,
-                                                G4FragmentVector& results,
-                                                FragmentQueue& nextStage) {
+template <class Traits>
+void BasicExcitationHandler<Traits>::ApplyMultiFragmentation(FragmentPtr&& fragment,
+                                                             G4FragmentVector& results,
+                                                             FragmentQueue& nextStage) {
+  const auto scope = StageScope(StatsOf(HandlerStats::MultiFragmentation), results);
   auto fragments = std::unique_ptr<G4FragmentVector>(multiFragmentationModel_->BreakItUp(*fragment));
   if (fragments == nullptr || fragments->size() <= 1) {
-    ClearSingularResults(*fragments, fragment.get());
-    nextStage.emplace(fragment.release());
+    if (fragments != nullptr) {
+      ClearSingularResults(*fragments, fragment.get(), *arena_);
+    }
+    nextStage.Push(std::move(fragment));
     return;
   }
 
-  GroupFragments(std::move(*fragments), results, nextStage);
+  GroupFragments(*fragments, results, nextStage);
 }
 
-void ExcitationHandler::ApplyFermiBreakUp(std::unique_ptr<G4Fragment>&& fragment,
-                                          G4FragmentVector& results,
-                                          FragmentQueue& nextStage) {
-  G4FragmentVector fragments;
-  fermiBreakUpModel_->BreakFragment(&fragments, fragment.get());
-
-  if (fragments.size() <= 1) {
-    ClearSingularResults(fragments, fragment.get());
-    nextStage.emplace(fragment.release());
+template <class Traits>
+void BasicExcitationHandler<Traits>::ApplyFermiBreakUp(FragmentPtr&& fragment,
+                                                       G4FragmentVector& results,
+                                                       FragmentQueue& nextStage) {
+  const auto scope = StageScope(StatsOf(HandlerStats::FermiBreakUp), results);
+  fermiBreakUpModel_->BreakFragment(&stageFragments_, fragment.get());
+
+  if (stageFragments_.size() <= 1) {
+    ClearSingularResults(stageFragments_, fragment.get(), *arena_);
+    stageFragments_.clear();
+    nextStage.Push(std::move(fragment));
     return;
   }
 
-  GroupFragments(std::move(fragments), results, nextStage);
+  GroupFragments(stageFragments_, results, nextStage);
 }
 
-void ExcitationHandler::ApplyEvaporation(std::unique_ptr<G4Fragment>&& fragment,
-                                         G4FragmentVector& results,
-                                         FragmentQueue& nextStage) {
-  G4FragmentVector fragments;
-  evaporationModel_->BreakFragment(&fragments, fragment.get());
+template <class Traits>
+void BasicExcitationHandler<Traits>::ApplyEvaporation(FragmentPtr&& fragment,
+                                                      G4FragmentVector& results,
+                                                      FragmentQueue& nextStage) {
+  const auto scope = StageScope(StatsOf(HandlerStats::Evaporation), results);
+  evaporationModel_->BreakFragment(&stageFragments_, fragment.get());
 
-  if (fragments.size() <= 1) {
-    ClearSingularResults(fragments, fragment.get());
+  if (stageFragments_.size() <= 1) {
+    ClearSingularResults(stageFragments_, fragment.get(), *arena_);
+    stageFragments_.clear();
     results.emplace_back(fragment.release());
     return;
   }
 
-  GroupFragments(std::move(fragments), results, nextStage);
+  GroupFragments(stageFragments_, results, nextStage);
 }
 
-void ExcitationHandler::ApplyPhotonEvaporation(std::unique_ptr<G4Fragment>&& fragment, G4FragmentVector& results) {
+template <class Traits>
+void BasicExcitationHandler<Traits>::ApplyPhotonEvaporation(FragmentPtr&& fragment, G4FragmentVector& results) {
+  const auto scope = StageScope(StatsOf(HandlerStats::PhotonEvaporation), results);
   // photon de-excitation only for hot fragments
   if (!IsGroundState(*fragment)) {
-    G4FragmentVector fragments;
+    photonEvaporationModel_->BreakUpChain(&stageFragments_, fragment.get());
 
-    photonEvaporationModel_->BreakUpChain(&fragments, fragment.get());
-
-    for (auto fragmentPtr : fragments) {
-      results.emplace_back(fragmentPtr);
-    }
+    results.insert(results.end(), stageFragments_.begin(), stageFragments_.end());
+    stageFragments_.clear();
   }
 
   // primary fragment is kept
   results.emplace_back(fragment.release());
 }
 
-void ExcitationHandler::ApplyPureNeutronDecay(std::unique_ptr<G4Fragment>&& fragment,
-                                              G4FragmentVector& results) {
+template <class Traits>
+void BasicExcitationHandler<Traits>::ApplyPureNeutronDecay(FragmentPtr&& fragment,
+                                                           G4FragmentVector& results) {
+  const auto scope = StageScope(StatsOf(HandlerStats::NeutronDecay), results);
   size_t oldSize = results.size();
-  neutronDecayModel_->BreakFragment(results, *fragment);
+  neutronDecayModel_->BreakFragment(results, *fragment, arena_.get());
 
   if (oldSize == results.size()) {
     results.emplace_back(fragment.release());
   }
 }
 
-void ExcitationHandler::GroupFragments(G4FragmentVector&& fragments,
-                                       G4FragmentVector& results,
-                                       FragmentQueue& nextStage) {
-  auto nist = G4NistManager::Instance();
+template <class Traits>
+void BasicExcitationHandler<Traits>::ApplyFallback(FragmentPtr&& fragment, G4FragmentVector& results) {
+  ++fallbackCount_;
+  results.emplace_back(fragment.release());
+}
+
+template <class Traits>
+void BasicExcitationHandler<Traits>::GroupFragments(G4FragmentVector& fragments,
+                                                    G4FragmentVector& results,
+                                                    FragmentQueue& nextStage) {
+  for (auto& slot : fragments) {
+    // ownership is taken out of the vector, so it is safe to clean on exception
+    auto fragmentPtr = std::exchange(slot, nullptr);
 
-  for (auto fragmentPtr : fragments) {
     // gamma, p, n or stable nuclei
     if (neutronDecayCondition_(*fragmentPtr)) {
-      ApplyPureNeutronDecay(std::unique_ptr<G4Fragment>(fragmentPtr), results);
-    } else if (IsStable(*fragmentPtr, nist)) {
+      ApplyPureNeutronDecay(FragmentPtr(fragmentPtr, arena_.get()), results);
+    } else if (IsStable(*fragmentPtr)) {
       results.emplace_back(fragmentPtr);
     } else {
-      nextStage.emplace(fragmentPtr);
+      nextStage.Push(fragmentPtr, arena_.get());
     }
   }
+  fragments.clear();
 }
 
-std::vector<G4ReactionProduct> ExcitationHandler::ConvertResults(const G4FragmentVector& results) {
-  std::vector<G4ReactionProduct> reactionProducts;
-  reactionProducts.reserve(results.size());
-  auto ionTable = G4ParticleTable::GetParticleTable()->GetIonTable();
+template <class Traits>
+void BasicExcitationHandler<Traits>::ConvertResults(const G4FragmentVector& results,
+                                                    std::vector<G4ReactionProduct>& reactionProducts) {
+  for (const auto& fragmentPtr : results) {
+    reactionProducts.emplace_back(ResolveDefinition(*fragmentPtr));
+    FillProduct(reactionProducts.back(), *fragmentPtr);
+  }
+}
 
+template <class Traits>
+void BasicExcitationHandler<Traits>::ConvertResults(const G4FragmentVector& results, const ProductSink& sink) {
   for (const auto& fragmentPtr : results) {
-    auto fragmentDefinition = SpecialParticleDefinition(*fragmentPtr);
-    if (fragmentDefinition == nullptr) {
-      auto excitationEnergy = fragmentPtr->GetExcitationEnergy();
-      auto level = fragmentPtr->GetFloatingLevelNumber();
-      if (IsGroundState(*fragmentPtr)) {
-        excitationEnergy = 0;
-        level = 0;
-      }
-      fragmentDefinition = ionTable->GetIon(fragmentPtr->GetZ_asInt(), fragmentPtr->GetA_asInt(),
-                                            excitationEnergy, G4Ions::FloatLevelBase(level));
+    auto product = G4ReactionProduct(ResolveDefinition(*fragmentPtr));
+    FillProduct(product, *fragmentPtr);
+    sink(product);
+  }
+}
+
+template <class Traits>
+template <class Real>
+void BasicExcitationHandler<Traits>::ConvertResults(const G4FragmentVector& results,
+                                                    BasicProductColumns<Real>& products) {
+  for (const auto& fragmentPtr : results) {
+    const auto definition = ResolveDefinition(*fragmentPtr);
+    const auto& momentum = fragmentPtr->GetMomentum();
+    products.pdg.push_back(definition->GetPDGEncoding());
+    products.A.push_back(definition->GetBaryonNumber());
+    products.Z.push_back(static_cast<std::int32_t>(std::lround(definition->GetPDGCharge() / CLHEP::eplus)));
+    products.px.push_back(static_cast<Real>(momentum.px()));
+    products.py.push_back(static_cast<Real>(momentum.py()));
+    products.pz.push_back(static_cast<Real>(momentum.pz()));
+    products.e.push_back(static_cast<Real>(momentum.e()));
+    products.t.push_back(static_cast<Real>(fragmentPtr->GetCreationTime()));
+  }
+}
+
+template <class Traits>
+G4ParticleDefinition* BasicExcitationHandler<Traits>::ResolveDefinition(G4Fragment& fragment) {
+  auto fragmentDefinition = SpecialParticleDefinition(fragment);
+  if (fragmentDefinition == nullptr) {
+    auto excitationEnergy = fragment.GetExcitationEnergy();
+    auto level = fragment.GetFloatingLevelNumber();
+    if (IsGroundState(fragment)) {
+      excitationEnergy = 0;
+      level = 0;
     }
-    // fragment wasn't found, ground state is created
+    fragmentDefinition = ionCache_.GetIon(fragment.GetZ_asInt(), fragment.GetA_asInt(),
+                                          excitationEnergy, G4Ions::FloatLevelBase(level));
+  }
+  // fragment wasn't found, ground state is created
+  if (fragmentDefinition == nullptr) {
+    fragmentDefinition = ionCache_.GetGroundState(fragment.GetZ_asInt(), fragment.GetA_asInt());
     if (fragmentDefinition == nullptr) {
-      fragmentDefinition = ionTable->GetIon(fragmentPtr->GetZ_asInt(), fragmentPtr->GetA_asInt(), 0, noFloat, 0);
-      if (fragmentDefinition == nullptr) {
-        throw std::runtime_error("ion table isn't created");
-      }
-      G4double ionMass = fragmentDefinition->GetPDGMass();
-      if (fragmentPtr->GetMomentum().e() <= ionMass) {
-        fragmentPtr->SetMomentum(G4LorentzVector(ionMass));
-      } else {
-        auto momentum = fragmentPtr->GetMomentum();
-        G4double momentumModulus = std::sqrt((momentum.e() - ionMass) * (momentum.e() + ionMass));
-        momentum.setVect(momentum.vect().unit() * momentumModulus);
-        fragmentPtr->SetMomentum(momentum);
-      }
+      throw std::runtime_error("ion table isn't created");
     }
-
-    reactionProducts.emplace_back(fragmentDefinition);
-    reactionProducts.back().SetMomentum(fragmentPtr->GetMomentum().vect());
-    reactionProducts.back().SetTotalEnergy((fragmentPtr->GetMomentum()).e());
-    reactionProducts.back().SetFormationTime(fragmentPtr->GetCreationTime());
+    PutOnMassShell(fragment, fragmentDefinition->GetPDGMass());
   }
 
-  return reactionProducts;
+  return fragmentDefinition;
 }
+
+template class BasicExcitationHandler<RuntimeHandlerTraits>;
+
+template class BasicExcitationHandler<StaticHandlerTraits>;
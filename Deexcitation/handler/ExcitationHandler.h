@@ -1,68 +1,198 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <optional>
 #include <vector>
-#include <queue>
 
 #include <G4Fragment.hh>
 #include <G4ReactionProductVector.hh>
 #include <G4IonTable.hh>
 #include <G4DeexPrecoParameters.hh>
-#include <G4FermiPhaseDecay.hh>
-#include <G4NistManager.hh>
 
 #include <G4VMultiFragmentation.hh>
 #include <G4VEvaporation.hh>
 #include <G4VFermiBreakUp.hh>
+#include <G4Evaporation.hh>
+#include <G4PhotonEvaporation.hh>
+#include <G4StatMF.hh>
+
+#include "Conditions.h"
+#include "ExcitationHandlerFwd.h"
+#include "FragmentArena.h"
+#include "HandlerStats.h"
+#include "IonDefinitionCache.h"
+#include "IonTableMode.h"
+#include "NeutronDecay.h"
+#include "ParticleEnvironment.h"
+#include "ProductColumns.h"
+#include "RandomStream.h"
+#include "StabilityTable.h"
+
+// conditions and models are configured at runtime through type erasure
+struct RuntimeHandlerTraits {
+  using Condition = std::function<bool(const G4Fragment&)>;
+
+  using MultiFragmentationModel = G4VMultiFragmentation;
+  using FermiBreakUpModel = G4VFermiBreakUp;
+  using EvaporationModel = G4VEvaporation;
+  using PhotonEvaporationModel = G4VEvaporationChannel;
+  using NeutronDecayModel = NeutronDecay;
+
+  using MultiFragmentationCondition = Condition;
+  using FermiBreakUpCondition = Condition;
+  using EvaporationCondition = Condition;
+  using PhotonEvaporationCondition = Condition;
+  using NeutronDecayCondition = Condition;
+};
 
-class ExcitationHandler {
+// default conditions and models are known at compile time, so conditions are inlined in the hot loop
+struct StaticHandlerTraits {
+  using MultiFragmentationModel = G4StatMF;
+  using FermiBreakUpModel = G4VFermiBreakUp;
+  using EvaporationModel = G4Evaporation;
+  using PhotonEvaporationModel = G4PhotonEvaporation;
+  using NeutronDecayModel = NeutronDecay;
+
+  using MultiFragmentationCondition = DefaultConditions::MultiFragmentation;
+  using FermiBreakUpCondition = DefaultConditions::FermiBreakUp;
+  using EvaporationCondition = DefaultConditions::Evaporation;
+  using PhotonEvaporationCondition = DefaultConditions::PhotonEvaporation;
+  using NeutronDecayCondition = DefaultConditions::NeutronDecay;
+};
+
+// Member definitions live in ExcitationHandler.cpp,
+// new traits have to be explicitly instantiated there.
+template <class Traits>
+class BasicExcitationHandler {
  private:
-  using FragmentQueue = std::queue<std::unique_ptr<G4Fragment>>;
+  using FragmentPtr = std::unique_ptr<G4Fragment, FragmentArena::Deleter>;
 
- public:
-  class NeutronDecay {
+  // FIFO over a flat vector, keeps its capacity between calls
+  class FragmentQueue {
    public:
-    NeutronDecay() = default;
+    bool Empty() const { return head_ == items_.size(); }
 
-    void BreakFragment(G4FragmentVector& results, const G4Fragment& fragment);
+    size_t Size() const { return items_.size() - head_; }
+
+    template <class... Args>
+    void Push(Args&&... args) { items_.emplace_back(std::forward<Args>(args)...); }
+
+    FragmentPtr Pop() {
+      auto fragment = std::move(items_[head_++]);
+      if (Empty()) {
+        Clear();
+      }
+      return fragment;
+    }
+
+    void Clear() {
+      items_.clear();
+      head_ = 0;
+    }
 
    private:
-    G4FermiPhaseDecay phaseSpaceDecay_;
+    std::vector<FragmentPtr> items_;
+    size_t head_ = 0;
   };
 
+ public:
+  using MultiFragmentationModel = typename Traits::MultiFragmentationModel;
+  using FermiBreakUpModel = typename Traits::FermiBreakUpModel;
+  using EvaporationModel = typename Traits::EvaporationModel;
+  using PhotonEvaporationModel = typename Traits::PhotonEvaporationModel;
+  using NeutronDecay = typename Traits::NeutronDecayModel;
+
+  using MultiFragmentationCondition = typename Traits::MultiFragmentationCondition;
+  using FermiBreakUpCondition = typename Traits::FermiBreakUpCondition;
+  using EvaporationCondition = typename Traits::EvaporationCondition;
+  using PhotonEvaporationCondition = typename Traits::PhotonEvaporationCondition;
+  using NeutronDecayCondition = typename Traits::NeutronDecayCondition;
+
   using Condition = std::function<bool(const G4Fragment&)>;
 
-  ExcitationHandler();
+  using ProductSink = std::function<void(const G4ReactionProduct&)>;
+
+  using FragmentSink = std::function<void(const G4Fragment&)>;
+
+  // fragmentIdx is the position of the input fragment the product comes from
+  using IndexedFragmentSink = std::function<void(size_t fragmentIdx, const G4Fragment&)>;
+
+  // Per input fragment limits, zero means unlimited, but at least one of them must be set.
+  // Out of budget or unroutable fragments are emitted as they are instead of aborting the run.
+  struct WorkBudget {
+    size_t maxIterations = 0;
+    std::chrono::nanoseconds maxTime{0};
+  };
+
+  // products of a batch, products of the i-th input fragment are [offsets[i], offsets[i + 1])
+  struct BatchResult {
+    std::vector<G4ReactionProduct> products;
+    std::vector<size_t> offsets;
+  };
+
+  explicit BasicExcitationHandler(IonTableMode ionTableMode = IonTableMode::Eager);
 
-  ExcitationHandler(const ExcitationHandler&) = delete;
+  BasicExcitationHandler(const BasicExcitationHandler&) = delete;
 
-  ExcitationHandler(ExcitationHandler&&) = default;
+  BasicExcitationHandler(BasicExcitationHandler&&) = default;
 
-  ~ExcitationHandler();
+  ~BasicExcitationHandler();
 
-  ExcitationHandler& operator=(const ExcitationHandler&) = delete;
+  BasicExcitationHandler& operator=(const BasicExcitationHandler&) = delete;
 
-  ExcitationHandler& operator=(ExcitationHandler&&) = default;
+  BasicExcitationHandler& operator=(BasicExcitationHandler&&) = default;
 
   std::vector<G4ReactionProduct> BreakItUp(const G4Fragment& fragment);
 
+  // products are appended, so the caller can reuse the vector's capacity
+  void BreakItUp(const G4Fragment& fragment, std::vector<G4ReactionProduct>& products);
+
+  // sink is called for each product, no product storage is allocated
+  void BreakItUp(const G4Fragment& fragment, const ProductSink& sink);
+
+  // final fragments are passed without building G4ReactionProduct, their momenta are the same as in BreakItUp:
+  // a fragment missing in the ion table is put on the mass shell of its ground state
+  void BreakItUpFragments(const G4Fragment& fragment, const FragmentSink& sink);
+
+  // runs only the evaporation and photon evaporation loop on the fragment, like the continuation of RunStages
+  // after multi-fragmentation; final fragments are passed as they are, used by the parallel evaporation workers
+  void EvaporateFragment(const G4Fragment& fragment, const FragmentSink& sink);
+
+  // Stage batched de-excitation: fragments of all inputs share per-stage work lists and every stage
+  // is drained for the whole batch before the next one, so each model's tables stay hot in cache.
+  // Products are passed grouped by input in input order, like in BreakItUpFragments.
+  // Random streams are keyed by (input, step), so results differ from the per-fragment mode.
+  // A time budget counts only the time spent in the steps of the input.
+  void BreakItUpStaged(const std::vector<G4Fragment>& fragments, const IndexedFragmentSink& sink);
+
+  // products are appended as columns, no G4ReactionProduct is built
+  void BreakItUp(const G4Fragment& fragment, ProductColumns& products);
+
+  void BreakItUp(const G4Fragment& fragment, ProductColumnsF& products);
+
+  // de-excites all fragments sharing scratch state, output is overwritten
+  void BreakItUp(const std::vector<G4Fragment>& fragments, BatchResult& output);
+
   // parameters setters
-  ExcitationHandler& SetMultiFragmentation(std::unique_ptr<G4VMultiFragmentation>&& model = DefaultMultiFragmentation()) {
+  BasicExcitationHandler& SetMultiFragmentation(std::unique_ptr<MultiFragmentationModel>&& model = DefaultMultiFragmentation()) {
     multiFragmentationModel_ = std::move(model);
     return *this;
   }
 
-  ExcitationHandler& SetFermiBreakUp(std::unique_ptr<G4VFermiBreakUp>&& model = DefaultFermiBreakUp(),
+  BasicExcitationHandler& SetFermiBreakUp(std::unique_ptr<FermiBreakUpModel>&& model = DefaultFermiBreakUp(),
                                      bool setModels = true) {
     fermiBreakUpModel_ = std::move(model);
+    BindFermiBreakUpArena();
     if (setModels) {
       evaporationModel_->SetFermiBreakUp(fermiBreakUpModel_.get());
     }
     return *this;
   }
 
-  ExcitationHandler& SetEvaporation(std::unique_ptr<G4VEvaporation>&& model = DefaultEvaporation(),
+  BasicExcitationHandler& SetEvaporation(std::unique_ptr<EvaporationModel>&& model = DefaultEvaporation(),
                                     bool setModels = true) {
     evaporationModel_ = std::move(model);
     if (setModels) {
@@ -72,7 +202,7 @@ class ExcitationHandler {
     return *this;
   }
 
-  ExcitationHandler& SetPhotonEvaporation(std::unique_ptr<G4VEvaporationChannel>&& model = DefaultPhotonEvaporation(),
+  BasicExcitationHandler& SetPhotonEvaporation(std::unique_ptr<PhotonEvaporationModel>&& model = DefaultPhotonEvaporation(),
                                           bool setModels = true) {
     photonEvaporationModel_ = std::move(model);
     if (setModels) {
@@ -81,160 +211,363 @@ class ExcitationHandler {
     return *this;
   }
 
-  ExcitationHandler& SetNeutronDecay(std::unique_ptr<NeutronDecay>&& model = DefaultNeutronDecay()) {
+  BasicExcitationHandler& SetNeutronDecay(std::unique_ptr<NeutronDecay>&& model = DefaultNeutronDecay()) {
     neutronDecayModel_ = std::move(model);
     return *this;
   }
 
   template <class F>
-  ExcitationHandler& SetMultiFragmentationCondition(F&& f) {
+  BasicExcitationHandler& SetMultiFragmentationCondition(F&& f) {
     multiFragmentationCondition_ = std::forward<F>(f);
     return *this;
   }
 
-  ExcitationHandler& SetMultiFragmentationCondition() {
+  BasicExcitationHandler& SetMultiFragmentationCondition() {
     return SetMultiFragmentationCondition(DefaultMultiFragmentationCondition());
   }
 
   template <class F>
-  ExcitationHandler& SetFermiBreakUpCondition(F&& f) {
+  BasicExcitationHandler& SetFermiBreakUpCondition(F&& f) {
     fermiCondition_ = std::forward<F>(f);
     return *this;
   }
 
-  ExcitationHandler& SetFermiBreakUpCondition() {
+  BasicExcitationHandler& SetFermiBreakUpCondition() {
     return SetFermiBreakUpCondition(DefaultFermiBreakUpCondition());
   }
 
   template <class F>
-  ExcitationHandler& SetEvaporationCondition(F&& f) {
+  BasicExcitationHandler& SetEvaporationCondition(F&& f) {
     evaporationCondition_ = std::forward<F>(f);
     return *this;
   }
 
-  ExcitationHandler& SetEvaporationCondition() {
+  BasicExcitationHandler& SetEvaporationCondition() {
     return SetEvaporationCondition(DefaultEvaporationCondition());
   }
 
   template <class F>
-  ExcitationHandler& SetPhotonEvaporationCondition(F&& f) {
+  BasicExcitationHandler& SetPhotonEvaporationCondition(F&& f) {
     photonEvaporationCondition_ = std::forward<F>(f);
     return *this;
   }
 
-  ExcitationHandler& SetPhotonEvaporationCondition() {
+  BasicExcitationHandler& SetPhotonEvaporationCondition() {
     return SetPhotonEvaporationCondition(DefaultPhotonEvaporationCondition());
   }
 
   template <class F>
-  ExcitationHandler& SetNeutronDecayCondition(F&& f) {
+  BasicExcitationHandler& SetNeutronDecayCondition(F&& f) {
     neutronDecayCondition_ = std::forward<F>(f);
     return *this;
   }
 
-  ExcitationHandler& SetNeutronDecayCondition() {
+  BasicExcitationHandler& SetNeutronDecayCondition() {
     return SetNeutronDecayCondition(DefaultNeutronDecayCondition());
   }
 
-  ExcitationHandler& SetStableThreshold(double threshold) {
+  BasicExcitationHandler& SetStableThreshold(double threshold) {
     stableThreshold_ = threshold;
     return *this;
   }
 
+  // without a budget an unroutable fragment throws, a stuck evaporation loop is fatal with or without it;
+  // a budget without any limit is rejected
+  BasicExcitationHandler& SetWorkBudget(const WorkBudget& budget);
+
+  BasicExcitationHandler& ResetWorkBudget() {
+    budget_.reset();
+    return *this;
+  }
+
+  // every de-excited fragment draws from its own stream, see SetStreamPosition
+  BasicExcitationHandler& EnableRandomStreams(std::uint64_t runSeed) {
+    randomStream_ = std::make_unique<RandomStream>(runSeed);
+    return *this;
+  }
+
+  BasicExcitationHandler& DisableRandomStreams() {
+    randomStream_.reset();
+    return *this;
+  }
+
+  // the next fragment uses stream (eventId, fragmentIdx), the following ones increment fragmentIdx
+  BasicExcitationHandler& SetStreamPosition(std::uint64_t eventId, std::uint64_t fragmentIdx) {
+    streamEventId_ = eventId;
+    streamFragmentIdx_ = fragmentIdx;
+    return *this;
+  }
+
+  // Multifragmentation products of a fragment are evaporated by the pool's handlers, when there are
+  // at least minFragments of them. Pool is not owned, its handlers must not use a parallel pool themselves.
+  // With random streams each product gets its own stream, so results do not depend on scheduling.
+  // Workers only evaporate, a work budget applies to each product separately.
+  // Only the per-fragment mode uses it, BreakItUpStaged keeps the batch on the calling thread.
+  BasicExcitationHandler& SetParallelEvaporation(HandlerPool* pool, size_t minFragments) {
+    parallelPool_ = pool;
+    parallelThreshold_ = minFragments;
+    return *this;
+  }
+
+  BasicExcitationHandler& DisableParallelEvaporation() {
+    parallelPool_ = nullptr;
+    return *this;
+  }
+
   // parameters getters
   std::unique_ptr<NeutronDecay>& GetNeutronDecay() { return neutronDecayModel_; }
 
   const std::unique_ptr<NeutronDecay>& GetNeutronDecay() const { return neutronDecayModel_; }
 
-  std::unique_ptr<G4VMultiFragmentation>& GetMultiFragmentation() { return multiFragmentationModel_; }
+  std::unique_ptr<MultiFragmentationModel>& GetMultiFragmentation() { return multiFragmentationModel_; }
 
-  const std::unique_ptr<G4VMultiFragmentation>& GetMultiFragmentation() const { return multiFragmentationModel_; }
+  const std::unique_ptr<MultiFragmentationModel>& GetMultiFragmentation() const { return multiFragmentationModel_; }
 
-  std::unique_ptr<G4VFermiBreakUp>& GetFermiBreakUp() { return fermiBreakUpModel_; }
+  std::unique_ptr<FermiBreakUpModel>& GetFermiBreakUp() { return fermiBreakUpModel_; }
 
-  const std::unique_ptr<G4VFermiBreakUp>& GetFermiBreakUp() const { return fermiBreakUpModel_; }
+  const std::unique_ptr<FermiBreakUpModel>& GetFermiBreakUp() const { return fermiBreakUpModel_; }
 
-  std::unique_ptr<G4VEvaporation>& GetEvaporation() { return evaporationModel_; }
+  std::unique_ptr<EvaporationModel>& GetEvaporation() { return evaporationModel_; }
 
-  const std::unique_ptr<G4VEvaporation>& GetEvaporation() const { return evaporationModel_; }
+  const std::unique_ptr<EvaporationModel>& GetEvaporation() const { return evaporationModel_; }
 
-  Condition& GetMultiFragmentationCondition() { return multiFragmentationCondition_; }
+  MultiFragmentationCondition& GetMultiFragmentationCondition() { return multiFragmentationCondition_; }
 
-  const Condition& GetMultiFragmentationCondition() const { return multiFragmentationCondition_; }
+  const MultiFragmentationCondition& GetMultiFragmentationCondition() const { return multiFragmentationCondition_; }
 
-  Condition& GetFermiBreakUpCondition() { return fermiCondition_; }
+  FermiBreakUpCondition& GetFermiBreakUpCondition() { return fermiCondition_; }
 
-  const Condition& GetFermiBreakUpCondition() const { return fermiCondition_; }
+  const FermiBreakUpCondition& GetFermiBreakUpCondition() const { return fermiCondition_; }
 
-  Condition& GetEvaporationCondition() { return evaporationCondition_; }
+  EvaporationCondition& GetEvaporationCondition() { return evaporationCondition_; }
 
-  const Condition& GetEvaporationCondition() const { return evaporationCondition_; }
+  const EvaporationCondition& GetEvaporationCondition() const { return evaporationCondition_; }
 
-  Condition& GetPhotonEvaporationCondition() { return photonEvaporationCondition_; }
+  PhotonEvaporationCondition& GetPhotonEvaporationCondition() { return photonEvaporationCondition_; }
 
-  const Condition& GetPhotonEvaporationCondition() const { return photonEvaporationCondition_; }
+  const PhotonEvaporationCondition& GetPhotonEvaporationCondition() const { return photonEvaporationCondition_; }
 
-  Condition& GetNeutronDecayCondition() { return neutronDecayCondition_; }
+  NeutronDecayCondition& GetNeutronDecayCondition() { return neutronDecayCondition_; }
 
-  const Condition& GetNeutronDecayCondition() const { return neutronDecayCondition_; }
+  const NeutronDecayCondition& GetNeutronDecayCondition() const { return neutronDecayCondition_; }
 
   double GetStableThreshold() const { return stableThreshold_; }
 
+  const StabilityTable& GetStabilityTable() const { return *stabilityTable_; }
+
+  // light particles and ground state nuclides with natural abundance are not de-excited
+  bool IsStable(const G4Fragment& fragment) const {
+    return fragment.GetA_asInt() <= 1
+           || (IsGroundState(fragment) && stabilityTable_->IsStable(fragment.GetZ_asInt(), fragment.GetA_asInt()));
+  }
+
+  // stats are off by default, disabled collection costs one branch per stage
+  BasicExcitationHandler& EnableStats(bool enable = true) {
+    statsEnabled_ = enable;
+    return *this;
+  }
+
+  bool IsStatsEnabled() const { return statsEnabled_; }
+
+  const HandlerStats& GetStats() const { return stats_; }
+
+  void ResetStats() { stats_.Reset(); }
+
+  const std::optional<WorkBudget>& GetWorkBudget() const { return budget_; }
+
+  // fragments emitted by the budget fallback since construction or the last reset
+  size_t GetFallbackCount() const { return fallbackCount_; }
+
+  void ResetFallbackCount() { fallbackCount_ = 0; }
+
+  bool HasRandomStreams() const { return randomStream_ != nullptr; }
+
+  IonTableMode GetIonTableMode() const { return ionTableMode_; }
+
+  // wall time spent in the constructor, including the first time setup of the shared particle environment
+  std::chrono::duration<double> GetStartupTime() const { return startupTime_; }
+
+  // useful in lazy mode, when the produced nuclides are known in advance
+  BasicExcitationHandler& PrewarmIons(const NuclideRange& range) {
+    ionCache_.Prewarm(range);
+    return *this;
+  }
+
+  // initializes models, loads nuclear level data and ions of the range and runs a few trial breakups of its heaviest
+  // stable nuclide, trial breakups use their own random engine and don't affect stats or ion cache counters;
+  // returns the time it took
+  std::chrono::duration<double> WarmUp(const NuclideRange& range);
+
+  // total time spent in WarmUp
+  std::chrono::duration<double> GetWarmUpTime() const { return warmUpTime_; }
+
+  // hit and miss counters of ion definition lookups
+  const IonDefinitionCache& GetIonCache() const { return ionCache_; }
+
+  void SetIonEnergyQuantum(G4double quantum) { ionCache_.SetEnergyQuantum(quantum); }
+
+  // number of fragment heap allocations served by the handler's arena instead
+  size_t GetAvoidedAllocations() const { return arena_->GetAvoidedAllocations(); }
+
  protected:
+  using Clock = std::chrono::steady_clock;
+
+  BasicExcitationHandler(IonTableMode ionTableMode, Clock::time_point startTime);
+
   // default models and conditions
-  static std::unique_ptr<G4VMultiFragmentation> DefaultMultiFragmentation();
+  static std::unique_ptr<MultiFragmentationModel> DefaultMultiFragmentation();
 
-  static std::unique_ptr<G4VFermiBreakUp> DefaultFermiBreakUp();
+  static std::unique_ptr<FermiBreakUpModel> DefaultFermiBreakUp();
 
-  static std::unique_ptr<G4VEvaporation> DefaultEvaporation();
+  static std::unique_ptr<EvaporationModel> DefaultEvaporation();
 
-  static std::unique_ptr<G4VEvaporationChannel> DefaultPhotonEvaporation();
+  static std::unique_ptr<PhotonEvaporationModel> DefaultPhotonEvaporation();
 
   static std::unique_ptr<NeutronDecay> DefaultNeutronDecay();
 
-  static Condition DefaultMultiFragmentationCondition();
+  static MultiFragmentationCondition DefaultMultiFragmentationCondition() { return DefaultConditions::MultiFragmentation{}; }
+
+  static FermiBreakUpCondition DefaultFermiBreakUpCondition() { return DefaultConditions::FermiBreakUp{}; }
+
+  static EvaporationCondition DefaultEvaporationCondition() { return DefaultConditions::Evaporation{}; }
+
+  static PhotonEvaporationCondition DefaultPhotonEvaporationCondition() { return DefaultConditions::PhotonEvaporation{}; }
+
+  static NeutronDecayCondition DefaultNeutronDecayCondition() { return DefaultConditions::NeutronDecay{}; }
+
+  template <class... Args>
+  FragmentPtr MakeFragment(Args&&... args) {
+    return FragmentPtr(arena_->Create(std::forward<Args>(args)...), FragmentArena::Deleter(arena_.get()));
+  }
+
+  void BindFermiBreakUpArena();
+
+  bool IsGroundState(const G4Fragment& fragment) const { return fragment.GetExcitationEnergy() < stableThreshold_; }
+
+  HandlerStats::StageStats* StatsOf(HandlerStats::Stage stage) {
+    return statsEnabled_ ? &stats_.stages[stage] : nullptr;
+  }
 
-  static Condition DefaultFermiBreakUpCondition();
+  // emits the fragment unchanged, when the work budget is exhausted or no model applies
+  void ApplyFallback(FragmentPtr&& fragment, G4FragmentVector& results);
 
-  static Condition DefaultEvaporationCondition();
+  // fills results_, scratch must be cleared by the caller
+  void Deexcite(const G4Fragment& fragment);
 
-  static Condition DefaultPhotonEvaporationCondition();
+  void RunStages(const G4Fragment& fragment);
 
-  static Condition DefaultNeutronDecayCondition();
+  // drains the evaporation and photon evaporation queues into results_, fragment is the input reported on errors
+  void RunEvaporationStages(const G4Fragment& fragment);
 
-  bool IsGroundState(const G4Fragment& fragment) const;
+  // hands the whole evaporation queue to the parallel pool and collects the products into results_
+  void EvaporateInParallel();
 
-  bool IsStable(const G4Fragment& fragment, const G4NistManager* nist) const;
+  // same mass correction as ConvertResults, definitions are resolved through the ion cache
+  void PrepareFinalFragment(G4Fragment& fragment);
 
-  void ApplyMultiFragmentation(std::unique_ptr<G4Fragment>&& fragment, G4FragmentVector& results,
+  // runs one step of the input's work in stage batched mode, new results are tagged with the input
+  template <class F>
+  void RunStagedStep(size_t fragmentIdx, F&& step);
+
+  bool IsStagedBudgetExhausted(size_t fragmentIdx);
+
+  void ClearStaged();
+
+  // destroys every fragment left in the scratch buffers, capacity is kept
+  void ClearScratch();
+
+  void ApplyMultiFragmentation(FragmentPtr&& fragment, G4FragmentVector& results,
                                FragmentQueue& nextStage);
 
-  void ApplyFermiBreakUp(std::unique_ptr<G4Fragment>&& fragment, G4FragmentVector& results,
+  void ApplyFermiBreakUp(FragmentPtr&& fragment, G4FragmentVector& results,
                          FragmentQueue& nextStage);
 
-  void ApplyEvaporation(std::unique_ptr<G4Fragment>&& fragment, G4FragmentVector& results,
+  void ApplyEvaporation(FragmentPtr&& fragment, G4FragmentVector& results,
                         FragmentQueue& nextStage);
 
-  void ApplyPhotonEvaporation(std::unique_ptr<G4Fragment>&& fragment, G4FragmentVector& results);
+  void ApplyPhotonEvaporation(FragmentPtr&& fragment, G4FragmentVector& results);
 
-  void ApplyPureNeutronDecay(std::unique_ptr<G4Fragment>&& fragment, G4FragmentVector& results);
+  void ApplyPureNeutronDecay(FragmentPtr&& fragment, G4FragmentVector& results);
 
-  void GroupFragments(G4FragmentVector&& fragments, G4FragmentVector& results,
+  // takes ownership of fragments and leaves the vector empty
+  void GroupFragments(G4FragmentVector& fragments, G4FragmentVector& results,
                       FragmentQueue& nextStage);
 
-  std::vector<G4ReactionProduct> ConvertResults(const G4FragmentVector& results);
+  void ConvertResults(const G4FragmentVector& results, std::vector<G4ReactionProduct>& reactionProducts);
+
+  void ConvertResults(const G4FragmentVector& results, const ProductSink& sink);
 
-  std::unique_ptr<G4VMultiFragmentation> multiFragmentationModel_;
-  std::unique_ptr<G4VFermiBreakUp> fermiBreakUpModel_;
-  std::unique_ptr<G4VEvaporation> evaporationModel_;
-  std::unique_ptr<G4VEvaporationChannel> photonEvaporationModel_;
+  template <class Real>
+  void ConvertResults(const G4FragmentVector& results, BasicProductColumns<Real>& products);
+
+  // ground state fallback may correct the fragment's momentum
+  G4ParticleDefinition* ResolveDefinition(G4Fragment& fragment);
+
+  std::unique_ptr<MultiFragmentationModel> multiFragmentationModel_;
+  std::unique_ptr<FermiBreakUpModel> fermiBreakUpModel_;
+  std::unique_ptr<EvaporationModel> evaporationModel_;
+  std::unique_ptr<PhotonEvaporationModel> photonEvaporationModel_;
   std::unique_ptr<NeutronDecay> neutronDecayModel_;
 
-  Condition multiFragmentationCondition_;
-  Condition fermiCondition_;
-  Condition photonEvaporationCondition_;
-  Condition evaporationCondition_;
-  Condition neutronDecayCondition_;
+  MultiFragmentationCondition multiFragmentationCondition_;
+  FermiBreakUpCondition fermiCondition_;
+  PhotonEvaporationCondition photonEvaporationCondition_;
+  EvaporationCondition evaporationCondition_;
+  NeutronDecayCondition neutronDecayCondition_;
 
   double stableThreshold_ = 0.;
+
+  const StabilityTable* stabilityTable_ = &StabilityTable::Instance();
+
+  IonTableMode ionTableMode_;
+
+  std::optional<WorkBudget> budget_;
+
+  std::unique_ptr<RandomStream> randomStream_;
+  std::uint64_t streamEventId_ = 0;
+  std::uint64_t streamFragmentIdx_ = 0;
+  size_t fallbackCount_ = 0;
+
+  HandlerPool* parallelPool_ = nullptr;
+  size_t parallelThreshold_ = 0;
+
+  bool statsEnabled_ = false;
+  HandlerStats stats_;
+  std::chrono::duration<double> startupTime_{};
+  std::chrono::duration<double> warmUpTime_{};
+
+  IonDefinitionCache ionCache_;
+
+  // heap allocated, so pointers held by models survive handler moves
+  std::unique_ptr<FragmentArena> arena_;
+
+  // scratch buffers reused between calls
+  G4FragmentVector results_;
+  G4FragmentVector stageFragments_;
+  FragmentQueue evaporationQueue_;
+  FragmentQueue photonEvaporationQueue_;
+
+  // stage batched mode scratch, work items are tagged with their input index
+  using StagedWork = std::vector<std::pair<FragmentPtr, size_t>>;
+  StagedWork stagedMultiFragmentation_;
+  StagedWork stagedRouting_;  // waiting for the next round to be routed to a stage
+  StagedWork stagedNeutronDecay_;
+  StagedWork stagedFermiBreakUp_;
+  StagedWork stagedEvaporation_;
+  StagedWork stagedPhotonEvaporation_;
+  std::vector<size_t> resultOrigins_;  // input index of every results_ entry
+  std::vector<size_t> stagedSteps_;
+  std::vector<size_t> stagedIterations_;
+  std::vector<std::chrono::nanoseconds> stagedElapsed_;  // time spent in the input's own steps
+  std::vector<bool> stagedExhausted_;
+  std::vector<size_t> stagedOffsets_;
+  std::vector<size_t> stagedOrder_;
+
+  // parallel evaporation scratch, products are kept per task to preserve the order
+  std::vector<G4Fragment> parallelFragments_;
+  std::vector<std::vector<G4Fragment>> parallelProducts_;
 };
+
+extern template class BasicExcitationHandler<RuntimeHandlerTraits>;
+
+extern template class BasicExcitationHandler<StaticHandlerTraits>;
@@ -0,0 +1,14 @@
+#pragma once
+
+template <class Traits>
+class BasicExcitationHandler;
+
+struct RuntimeHandlerTraits;
+
+struct StaticHandlerTraits;
+
+using ExcitationHandler = BasicExcitationHandler<RuntimeHandlerTraits>;
+
+using StaticExcitationHandler = BasicExcitationHandler<StaticHandlerTraits>;
+
+class HandlerPool;
@@ -0,0 +1,45 @@
+#ifdef DEEXCITATION_WITH_FBU
+
+#include <G4FermiBreakUpAN.hh>
+
+#include "FbuFermiBreakUp.h"
+
+std::unique_ptr<FbuFermiBreakUp> FbuFermiBreakUp::Create(std::unique_ptr<fbu::FermiBreakUp::SplitCache>&& cache) {
+  if (cache == nullptr) {
+    return std::make_unique<FbuFermiBreakUp>(fbu::FermiBreakUp());
+  }
+
+  auto countingCache = std::make_unique<CountingSplitCache>(std::move(cache));
+  const auto cachePtr = countingCache.get();
+  auto wrapper = std::make_unique<FbuFermiBreakUp>(fbu::FermiBreakUp(std::move(countingCache)));
+  wrapper->cache_ = cachePtr;
+  return wrapper;
+}
+
+G4bool FbuFermiBreakUp::IsApplicable(G4int Z, G4int A, G4double) const {
+  return Z < MAX_Z && A < MAX_A;
+}
+
+void FbuFermiBreakUp::BreakFragment(G4FragmentVector* results, G4Fragment* theNucleus) {
+  const auto particles = model_.BreakItUp(fbu::Particle(
+    fbu::AtomicMass(theNucleus->GetA_asInt()),
+    fbu::ChargeNumber(theNucleus->GetZ_asInt()),
+    theNucleus->GetMomentum()
+  ));
+
+  // the nucleus stays with the caller, like in G4FermiBreakUpAN
+  if (particles.size() <= 1) {
+    return;
+  }
+
+  results->reserve(results->size() + particles.size());
+  for (const auto& particle : particles) {
+    results->push_back(new G4Fragment(
+      static_cast<G4int>(particle.GetAtomicMass()),
+      static_cast<G4int>(particle.GetChargeNumber()),
+      particle.GetMomentum()
+    ));
+  }
+}
+
+#endif // DEEXCITATION_WITH_FBU
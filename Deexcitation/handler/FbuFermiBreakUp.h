@@ -0,0 +1,63 @@
+#pragma once
+
+// available when the library is built against the standalone FermiBreakUp package
+#ifdef DEEXCITATION_WITH_FBU
+
+#include <cstddef>
+#include <memory>
+
+#include <G4VFermiBreakUp.hh>
+
+#include "FermiBreakUp/FermiBreakUp.h"
+#include "FermiBreakUp/util/Cache.h"
+
+// Split cache decorator counting lookups of the wrapped cache.
+class CountingSplitCache : public fbu::FermiBreakUp::SplitCache {
+ public:
+  CountingSplitCache(std::unique_ptr<fbu::FermiBreakUp::SplitCache>&& cache) : cache_(std::move(cache)) {}
+
+  std::shared_ptr<fbu::FragmentSplits> Insert(const fbu::NucleiData& key, fbu::FragmentSplits&& value) override {
+    return cache_->Insert(key, std::move(value));
+  }
+
+  std::shared_ptr<fbu::FragmentSplits> Get(const fbu::NucleiData& key) override {
+    auto value = cache_->Get(key);
+    ++(value != nullptr ? hits_ : misses_);
+    return value;
+  }
+
+  size_t GetHits() const { return hits_; }
+
+  size_t GetMisses() const { return misses_; }
+
+ private:
+  std::unique_ptr<fbu::FermiBreakUp::SplitCache> cache_;
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+};
+
+// Standalone FermiBreakUp model behind the Geant4 interface.
+class FbuFermiBreakUp : public G4VFermiBreakUp {
+ public:
+  FbuFermiBreakUp(fbu::FermiBreakUp&& model) : model_(std::move(model)) {}
+
+  // lookups of the cache are counted, nullptr means no cache
+  static std::unique_ptr<FbuFermiBreakUp> Create(std::unique_ptr<fbu::FermiBreakUp::SplitCache>&& cache);
+
+  void Initialise() override {}
+
+  G4bool IsApplicable(G4int Z, G4int A, G4double eexc) const override;
+
+  void BreakFragment(G4FragmentVector* results, G4Fragment* theNucleus) override;
+
+  // zeros for a wrapper made without Create
+  size_t GetCacheHits() const { return cache_ != nullptr ? cache_->GetHits() : 0; }
+
+  size_t GetCacheMisses() const { return cache_ != nullptr ? cache_->GetMisses() : 0; }
+
+ private:
+  fbu::FermiBreakUp model_;
+  const CountingSplitCache* cache_ = nullptr;
+};
+
+#endif // DEEXCITATION_WITH_FBU
@@ -0,0 +1,45 @@
+#include <functional>
+
+#include "FragmentArena.h"
+
+void FragmentArena::Deleter::operator()(G4Fragment* fragment) const {
+  if (arena_ != nullptr) {
+    arena_->Destroy(fragment);
+  } else {
+    delete fragment;
+  }
+}
+
+void FragmentArena::Destroy(G4Fragment* fragment) {
+  if (fragment == nullptr) {
+    return;
+  }
+
+  if (Owns(fragment)) {
+    fragment->~G4Fragment();
+  } else {
+    delete fragment;
+  }
+}
+
+bool FragmentArena::Owns(const G4Fragment* fragment) const {
+  const auto ptr = reinterpret_cast<const Slot*>(fragment);
+  for (const auto& block : blocks_) {
+    if (!std::less<const Slot*>()(ptr, block.get()) && std::less<const Slot*>()(ptr, block.get() + BlockSize)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void* FragmentArena::Allocate() {
+  const auto blockIdx = used_ / BlockSize;
+  if (blockIdx == blocks_.size()) {
+    blocks_.emplace_back(std::make_unique<Slot[]>(BlockSize));
+  }
+  // a fragment in a fresh block is one heap allocation avoided as well, blocks are counted on their own
+  ++avoidedAllocations_;
+
+  return &blocks_[blockIdx][used_++ % BlockSize];
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <G4Fragment.hh>
+
+// Bump storage for fragments created by the handler itself.
+// Fragments coming from Geant4 models live on the heap, Destroy handles both kinds.
+class FragmentArena {
+ public:
+  class Deleter {
+   public:
+    Deleter(FragmentArena* arena = nullptr) : arena_(arena) {}
+
+    void operator()(G4Fragment* fragment) const;
+
+   private:
+    FragmentArena* arena_;
+  };
+
+  FragmentArena() = default;
+
+  FragmentArena(const FragmentArena&) = delete;
+
+  FragmentArena& operator=(const FragmentArena&) = delete;
+
+  template <class... Args>
+  G4Fragment* Create(Args&&... args) {
+    // G4Fragment has its own operator new, so global placement new is requested explicitly
+    return ::new (Allocate()) G4Fragment(std::forward<Args>(args)...);
+  }
+
+  // arena memory is kept until Reset, heap fragments are deleted
+  void Destroy(G4Fragment* fragment);
+
+  bool Owns(const G4Fragment* fragment) const;
+
+  // every fragment created since the previous reset must already be destroyed
+  void Reset() { used_ = 0; }
+
+  // fragments created in the arena, each one would be a heap allocation otherwise
+  size_t GetAvoidedAllocations() const { return avoidedAllocations_; }
+
+  size_t GetBlockAllocations() const { return blocks_.size(); }
+
+ private:
+  using Slot = std::aligned_storage_t<sizeof(G4Fragment), alignof(G4Fragment)>;
+
+  static constexpr size_t BlockSize = 64;
+
+  void* Allocate();
+
+  std::vector<std::unique_ptr<Slot[]>> blocks_;
+  size_t used_ = 0;
+  size_t avoidedAllocations_ = 0;
+};
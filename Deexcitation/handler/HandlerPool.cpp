@@ -0,0 +1,156 @@
+#include <limits>
+#include <stdexcept>
+
+#include <CLHEP/Random/MixMaxRng.h>
+#include <Randomize.hh>
+
+#include "ExcitationHandler.h"
+#include "ParticleEnvironment.h"
+
+#include "HandlerPool.h"
+
+HandlerPool::HandlerPool(const Builder& builder, size_t threads) {
+#ifndef G4MULTITHREADED
+  // random engine and model tables are process-wide in sequential Geant4 builds
+  throw std::runtime_error("HandlerPool requires Geant4 built with multithreading support");
+#endif
+
+  if (threads == 0) {
+    throw std::runtime_error("HandlerPool requires at least one thread");
+  }
+
+  // workers copy the master particle table, so it has to be complete before they start
+  ParticleEnvironment::Initialize(IonTableMode::Lazy);
+
+  // worker engines are seeded from the caller's engine, so a fixed seed reproduces the run
+  workers_.reserve(threads);
+  handlers_.assign(threads, nullptr);
+  for (size_t i = 0; i < threads; ++i) {
+    const auto seed = static_cast<long>(G4RandFlat::shootInt(std::numeric_limits<int>::max()));
+    workers_.emplace_back(&HandlerPool::WorkerLoop, this, std::cref(builder), seed, i);
+  }
+
+  std::unique_lock lock(mutex_);
+  done_.wait(lock, [this] { return readyWorkers_ == workers_.size(); });
+  if (error_) {
+    auto error = error_;
+    lock.unlock();
+    Stop();
+    std::rethrow_exception(error);
+  }
+}
+
+HandlerPool::~HandlerPool() {
+  Stop();
+}
+
+void HandlerPool::Run(size_t taskCount, const Task& task) {
+  if (taskCount == 0) {
+    return;
+  }
+
+  std::unique_lock lock(mutex_);
+  task_ = &task;
+  taskCount_ = taskCount;
+  nextTask_ = 0;
+  busyWorkers_ = workers_.size();
+  ++generation_;
+  wakeUp_.notify_all();
+
+  done_.wait(lock, [this] { return busyWorkers_ == 0; });
+  task_ = nullptr;
+
+  if (error_) {
+    auto error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void HandlerPool::ForEachHandler(const std::function<void(const ExcitationHandler& handler)>& visitor) const {
+  for (const auto handler : handlers_) {
+    if (handler != nullptr) {
+      visitor(*handler);
+    }
+  }
+}
+
+void HandlerPool::WorkerLoop(const Builder& builder, long seed, size_t workerIdx) {
+  CLHEP::MixMaxRng engine(seed);
+  G4Random::setTheEngine(&engine);
+
+  // outlives the handler, which uses the thread-local tables
+  const ParticleEnvironment::WorkerScope workerScope;
+  std::unique_ptr<ExcitationHandler> handler;
+  try {
+    // particle and ion tables are shared, so handlers are built one at a time
+    std::lock_guard buildLock(buildMutex_);
+    handler = builder();
+  } catch (...) {
+    std::lock_guard lock(mutex_);
+    if (!error_) {
+      error_ = std::current_exception();
+    }
+  }
+
+  size_t generation;
+  {
+    std::lock_guard lock(mutex_);
+    generation = generation_;
+    handlers_[workerIdx] = handler.get();
+    ++readyWorkers_;
+    done_.notify_all();
+  }
+
+  if (handler == nullptr) {
+    return;
+  }
+
+  while (true) {
+    {
+      std::unique_lock lock(mutex_);
+      wakeUp_.wait(lock, [this, generation] { return stop_ || generation_ != generation; });
+      if (stop_) {
+        return;
+      }
+      generation = generation_;
+    }
+
+    ProcessTasks(*handler);
+
+    {
+      std::lock_guard lock(mutex_);
+      if (--busyWorkers_ == 0) {
+        done_.notify_all();
+      }
+    }
+  }
+}
+
+void HandlerPool::ProcessTasks(ExcitationHandler& handler) {
+  for (auto idx = nextTask_.fetch_add(1); idx < taskCount_; idx = nextTask_.fetch_add(1)) {
+    try {
+      (*task_)(handler, idx);
+    } catch (...) {
+      std::lock_guard lock(mutex_);
+      if (!error_) {
+        error_ = std::current_exception();
+      }
+      nextTask_ = taskCount_;
+    }
+  }
+}
+
+void HandlerPool::Stop() {
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+  }
+  wakeUp_.notify_all();
+
+  for (auto& worker : workers_) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ExcitationHandlerFwd.h"
+
+// Fixed set of worker threads, each owning an ExcitationHandler and a random engine.
+// Handlers are built on their own thread, because Geant4 models keep thread-local state.
+class HandlerPool {
+ public:
+  using Builder = std::function<std::unique_ptr<ExcitationHandler>()>;
+  using Task = std::function<void(ExcitationHandler& handler, size_t taskIdx)>;
+
+  HandlerPool(const Builder& builder, size_t threads);
+
+  HandlerPool(const HandlerPool&) = delete;
+
+  HandlerPool(HandlerPool&&) = delete;
+
+  ~HandlerPool();
+
+  HandlerPool& operator=(const HandlerPool&) = delete;
+
+  HandlerPool& operator=(HandlerPool&&) = delete;
+
+  size_t GetSize() const { return workers_.size(); }
+
+  // runs task(handler, idx) for every idx in [0, taskCount), blocks until all of them are finished
+  void Run(size_t taskCount, const Task& task);
+
+  // visits every worker's handler on the calling thread, must not overlap with Run
+  void ForEachHandler(const std::function<void(const ExcitationHandler& handler)>& visitor) const;
+
+ private:
+  void WorkerLoop(const Builder& builder, long seed, size_t workerIdx);
+
+  void ProcessTasks(ExcitationHandler& handler);
+
+  void Stop();
+
+  std::vector<std::thread> workers_;
+  std::vector<ExcitationHandler*> handlers_;
+
+  std::mutex buildMutex_;
+  std::mutex mutex_;
+  std::condition_variable wakeUp_;
+  std::condition_variable done_;
+
+  const Task* task_ = nullptr;
+  size_t taskCount_ = 0;
+  std::atomic<size_t> nextTask_ = 0;
+  size_t generation_ = 0;
+  size_t busyWorkers_ = 0;
+  size_t readyWorkers_ = 0;
+  bool stop_ = false;
+  std::exception_ptr error_;
+};
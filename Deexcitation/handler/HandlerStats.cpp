@@ -0,0 +1,65 @@
+#include <algorithm>
+
+#include "HandlerStats.h"
+
+const char* HandlerStats::StageName(Stage stage) {
+  switch (stage) {
+    case MultiFragmentation:
+      return "MultiFragmentation";
+    case FermiBreakUp:
+      return "FermiBreakUp";
+    case Evaporation:
+      return "Evaporation";
+    case PhotonEvaporation:
+      return "PhotonEvaporation";
+    case NeutronDecay:
+      return "NeutronDecay";
+    default:
+      return "Unknown";
+  }
+}
+
+void HandlerStats::RecordIterations(size_t iterations) {
+  size_t bucket = 0;
+  while (iterations != 0 && bucket + 1 < IterationBuckets) {
+    iterations >>= 1;
+    ++bucket;
+  }
+  ++evaporationIterations[bucket];
+}
+
+HandlerStats& HandlerStats::operator+=(const HandlerStats& other) {
+  for (size_t stage = 0; stage < StageCount; ++stage) {
+    stages[stage].calls += other.stages[stage].calls;
+    stages[stage].time += other.stages[stage].time;
+    stages[stage].products += other.stages[stage].products;
+  }
+  for (size_t bucket = 0; bucket < IterationBuckets; ++bucket) {
+    evaporationIterations[bucket] += other.evaporationIterations[bucket];
+  }
+  evaporationQueueHighWater = std::max(evaporationQueueHighWater, other.evaporationQueueHighWater);
+  photonEvaporationQueueHighWater = std::max(photonEvaporationQueueHighWater, other.photonEvaporationQueueHighWater);
+  return *this;
+}
+
+std::ostream& operator<<(std::ostream& out, const HandlerStats& stats) {
+  out << "stage calls time[ms] products\n";
+  for (size_t stage = 0; stage < HandlerStats::StageCount; ++stage) {
+    const auto& stageStats = stats.stages[stage];
+    out << HandlerStats::StageName(HandlerStats::Stage(stage))
+        << ' ' << stageStats.calls
+        << ' ' << std::chrono::duration<double, std::milli>(stageStats.time).count()
+        << ' ' << stageStats.products
+        << '\n';
+  }
+
+  out << "evaporation iterations:";
+  for (size_t bucket = 0; bucket < HandlerStats::IterationBuckets; ++bucket) {
+    out << ' ' << (bucket == 0 ? 0 : size_t(1) << (bucket - 1)) << ':' << stats.evaporationIterations[bucket];
+  }
+  out << '\n';
+
+  out << "queue high water: evaporation " << stats.evaporationQueueHighWater
+      << ", photon evaporation " << stats.photonEvaporationQueueHighWater << '\n';
+  return out;
+}
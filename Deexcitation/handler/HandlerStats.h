@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <utility>
+
+#include <G4Fragment.hh>
+
+// Opt-in counters of a handler, collected only when enabled.
+struct HandlerStats {
+  enum Stage : size_t {
+    MultiFragmentation,
+    FermiBreakUp,
+    Evaporation,
+    PhotonEvaporation,
+    NeutronDecay,
+    StageCount,
+  };
+
+  struct StageStats {
+    size_t calls = 0;
+    std::chrono::nanoseconds time{};
+    size_t products = 0;  // fragments moved to the final results
+  };
+
+  // bucket 0 counts zero iterations, bucket i counts [2^(i - 1), 2^i), the last one is open
+  static constexpr size_t IterationBuckets = 12;
+
+  static const char* StageName(Stage stage);
+
+  void RecordIterations(size_t iterations);
+
+  void Reset() { *this = HandlerStats(); }
+
+  HandlerStats& operator+=(const HandlerStats& other);
+
+  std::array<StageStats, StageCount> stages{};
+  std::array<size_t, IterationBuckets> evaporationIterations{};
+  size_t evaporationQueueHighWater = 0;
+  size_t photonEvaporationQueueHighWater = 0;
+};
+
+std::ostream& operator<<(std::ostream& out, const HandlerStats& stats);
+
+// Measures a single Apply* call, does nothing for a null stats pointer.
+// Scopes opened inside another one (neutron decay of grouped fragments) are booked to their own stage only,
+// so stage totals don't overlap.
+class StageScope {
+ public:
+  StageScope(HandlerStats::StageStats* stats, const G4FragmentVector& results)
+    : stats_(stats), results_(results) {
+    if (stats_ != nullptr) {
+      resultsSize_ = results_.size();
+      parent_ = std::exchange(active_, this);
+      startTime_ = Clock::now();
+    }
+  }
+
+  StageScope(const StageScope&) = delete;
+
+  StageScope& operator=(const StageScope&) = delete;
+
+  ~StageScope() {
+    if (stats_ != nullptr) {
+      const auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - startTime_);
+      const auto products = results_.size() - resultsSize_;
+      ++stats_->calls;
+      stats_->time += time - nestedTime_;
+      stats_->products += products - nestedProducts_;
+
+      active_ = parent_;
+      if (parent_ != nullptr) {
+        parent_->nestedTime_ += time;
+        if (&parent_->results_ == &results_) {
+          parent_->nestedProducts_ += products;
+        }
+      }
+    }
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  static inline thread_local StageScope* active_ = nullptr;
+
+  HandlerStats::StageStats* stats_;
+  const G4FragmentVector& results_;
+  size_t resultsSize_ = 0;
+  Clock::time_point startTime_;
+  StageScope* parent_ = nullptr;
+  std::chrono::nanoseconds nestedTime_{};
+  size_t nestedProducts_ = 0;
+};
@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <cmath>
+
+#include <G4NuclideTable.hh>
+#include <G4ParticleTable.hh>
+
+#include "IonDefinitionCache.h"
+
+IonDefinitionCache::IonDefinitionCache()
+  : ionTable_(G4ParticleTable::GetParticleTable()->GetIonTable())
+  , energyQuantum_(G4NuclideTable::GetInstance()->GetLevelTolerance())
+  , groundStates_(static_cast<size_t>(MaxZ + 1) * (MaxA + 1), nullptr) {}
+
+G4ParticleDefinition* IonDefinitionCache::GetGroundState(G4int Z, G4int A) {
+  if (!InRange(Z, A)) {
+    ++misses_;
+    return ionTable_->GetIon(Z, A, 0, noFloat, 0);
+  }
+
+  auto& definition = groundStates_[static_cast<size_t>(Z) * (MaxA + 1) + A];
+  if (definition != nullptr) {
+    ++hits_;
+    return definition;
+  }
+
+  ++misses_;
+  definition = ionTable_->GetIon(Z, A, 0, noFloat, 0);
+  return definition;
+}
+
+void IonDefinitionCache::Prewarm(const NuclideRange& range) {
+  for (auto Z = std::max(range.minZ, 0); Z <= std::min(range.maxZ, MaxZ); ++Z) {
+    for (auto A = std::max({range.minA, Z, 1}); A <= std::min(range.maxA, MaxA); ++A) {
+      auto& definition = groundStates_[static_cast<size_t>(Z) * (MaxA + 1) + A];
+      if (definition == nullptr) {
+        definition = ionTable_->GetIon(Z, A, 0, noFloat, 0);
+      }
+    }
+  }
+}
+
+G4ParticleDefinition* IonDefinitionCache::GetIon(G4int Z, G4int A, G4double excitationEnergy,
+                                                 G4Ions::G4FloatLevelBase level) {
+  if (excitationEnergy == 0 && level == noFloat) {
+    return GetGroundState(Z, A);
+  }
+
+  if (energyQuantum_ <= 0) {
+    ++misses_;
+    return ionTable_->GetIon(Z, A, excitationEnergy, level);
+  }
+
+  const auto key = Key{
+    Z,
+    A,
+    static_cast<G4int>(level),
+    std::llround(excitationEnergy / energyQuantum_),
+  };
+  if (const auto it = excited_.find(key); it != excited_.end()) {
+    ++hits_;
+    return it->second;
+  }
+
+  ++misses_;
+  const auto definition = ionTable_->GetIon(Z, A, excitationEnergy, level);
+  excited_.emplace(key, definition);
+  return definition;
+}
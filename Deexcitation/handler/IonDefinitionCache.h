@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include <G4IonTable.hh>
+#include <G4ParticleDefinition.hh>
+
+#include "NuclideRange.h"
+
+// Per handler memo of G4IonTable lookups.
+// Ground states are indexed directly by (Z, A), excited states are keyed by (Z, A, floating level, quantized E*).
+class IonDefinitionCache {
+ public:
+  static constexpr G4int MaxZ = NuclideChart::MaxZ;
+  static constexpr G4int MaxA = NuclideChart::MaxA;
+
+  IonDefinitionCache();
+
+  G4ParticleDefinition* GetGroundState(G4int Z, G4int A);
+
+  // creates ground states of the range ahead of time, counters aren't touched
+  void Prewarm(const NuclideRange& range);
+
+  // may return nullptr, when the ion table can't create such an ion
+  G4ParticleDefinition* GetIon(G4int Z, G4int A, G4double excitationEnergy, G4Ions::G4FloatLevelBase level);
+
+  // excitation energies closer than the quantum share a definition, by default it is the nuclide table tolerance,
+  // non positive quantum disables caching of excited states
+  void SetEnergyQuantum(G4double quantum) { energyQuantum_ = quantum; excited_.clear(); }
+
+  G4double GetEnergyQuantum() const { return energyQuantum_; }
+
+  size_t GetHits() const { return hits_; }
+
+  size_t GetMisses() const { return misses_; }
+
+  // puts back counters saved before lookups that shouldn't be counted
+  void RestoreCounters(size_t hits, size_t misses) { hits_ = hits; misses_ = misses; }
+
+ private:
+  struct Key {
+    G4int Z;
+    G4int A;
+    G4int level;
+    std::int64_t energy;
+
+    bool operator==(const Key& other) const {
+      return Z == other.Z && A == other.A && level == other.level && energy == other.energy;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      auto hash = std::hash<std::int64_t>()(key.energy);
+      hash ^= std::hash<G4int>()(key.Z * (MaxA + 1) + key.A) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+      hash ^= std::hash<G4int>()(key.level) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+      return hash;
+    }
+  };
+
+  static bool InRange(G4int Z, G4int A) { return Z >= 0 && Z <= MaxZ && A >= 0 && A <= MaxA; }
+
+  G4IonTable* ionTable_;
+  G4double energyQuantum_;
+
+  std::vector<G4ParticleDefinition*> groundStates_;
+  std::unordered_map<Key, G4ParticleDefinition*, KeyHash> excited_;
+
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+};
@@ -0,0 +1,8 @@
+#pragma once
+
+// Eager creates every ion and isomer at construction,
+// Lazy creates ions when a run first produces them.
+enum class IonTableMode {
+  Eager,
+  Lazy,
+};
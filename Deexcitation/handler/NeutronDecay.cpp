@@ -0,0 +1,133 @@
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cmath>
+
+#include <CLHEP/Units/PhysicalConstants.h>
+#include <Randomize.hh>
+
+#include "NeutronDecay.h"
+
+namespace {
+  // momentum of the products of a two-body decay in the parent's rest frame
+  G4double TwoBodyMomentum(G4double parentMass, G4double mass1, G4double mass2) {
+    const auto sum = mass1 + mass2;
+    const auto diff = mass1 - mass2;
+    const auto value = (parentMass * parentMass - sum * sum) * (parentMass * parentMass - diff * diff);
+    return value > 0 ? std::sqrt(value) / (2 * parentMass) : 0;
+  }
+
+  G4ThreeVector IsotropicDirection() {
+    const auto cosTheta = 2 * G4RandFlat::shoot() - 1;
+    const auto sinTheta = std::sqrt((1 - cosTheta) * (1 + cosTheta));
+    const auto phi = CLHEP::twopi * G4RandFlat::shoot();
+    return {sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta};
+  }
+
+  G4Fragment* MakeNeutron(const G4LorentzVector& momentum, FragmentArena* arena) {
+    return arena != nullptr ? arena->Create(1, 0, momentum) : new G4Fragment(1, 0, momentum);
+  }
+} // namespace
+
+void NeutronDecay::BreakFragment(G4FragmentVector& results, const G4Fragment& fragment, FragmentArena* arena) {
+  if (fragment.GetZ_asInt() != 0) {
+    throw std::runtime_error("only Z = 0 particles can be decayed by NeutronDecay, but got: A = "
+      + std::to_string(fragment.GetA_asInt()) + ", Z = " + std::to_string(fragment.GetZ_asInt()));
+  }
+
+  if (fragment.GetA_asInt() == 1) {
+    return;
+  }
+
+  auto momentum = fragment.GetMomentum();
+  if (const auto diff = momentum.m() - CLHEP::neutron_mass_c2 * fragment.GetA_asInt(); diff < 10. * CLHEP::eV) {
+    momentum.setE(momentum.e() + 10. * CLHEP::eV - diff);
+  }
+
+  if (fastPaths_ && fragment.GetA_asInt() == 2) {
+    TwoBodyDecay(results, momentum, arena);
+    return;
+  }
+
+  if (fastPaths_ && fragment.GetA_asInt() == 3) {
+    ThreeBodyDecay(results, momentum, arena);
+    return;
+  }
+
+  const auto masses = std::vector<G4double>(fragment.GetA_asInt(), CLHEP::neutron_mass_c2);
+  const auto particlesMomentum = phaseSpaceDecay_.CalculateDecay(momentum, masses);
+  if (particlesMomentum.size() == 0) {
+    std::stringstream ss;
+    ss << "NeutronDecay is unable to break particle with "
+     << "A = " << fragment.GetA_asInt()
+     << ", Z = " << fragment.GetZ_asInt()
+     << ", P = " << momentum
+    ;
+    throw std::runtime_error(ss.str());
+  }
+
+  for (const auto& momentum : particlesMomentum) {
+    results.emplace_back(MakeNeutron(momentum, arena));
+  }
+}
+
+void NeutronDecay::TwoBodyDecay(G4FragmentVector& results, const G4LorentzVector& momentum, FragmentArena* arena) {
+  constexpr auto mass = CLHEP::neutron_mass_c2;
+  const auto parentMass = momentum.m();
+  const auto boost = momentum.boostVector();
+
+  const auto p = IsotropicDirection() * TwoBodyMomentum(parentMass, mass, mass);
+  const auto energy = parentMass / 2;
+
+  auto first = G4LorentzVector(p, energy);
+  auto second = G4LorentzVector(-p, energy);
+  first.boost(boost);
+  second.boost(boost);
+
+  results.emplace_back(MakeNeutron(first, arena));
+  results.emplace_back(MakeNeutron(second, arena));
+}
+
+// Raubold-Lynch sampling for three equal masses: the pair mass is drawn uniformly
+// and accepted with the product of both two-body momenta. The outer momentum falls and the inner one grows
+// with the pair mass, so the outer one at the lightest pair times the inner one at the heaviest pair bounds it.
+void NeutronDecay::ThreeBodyDecay(G4FragmentVector& results, const G4LorentzVector& momentum, FragmentArena* arena) {
+  constexpr auto mass = CLHEP::neutron_mass_c2;
+  const auto parentMass = momentum.m();
+  const auto boost = momentum.boostVector();
+
+  const auto minPairMass = 2 * mass;
+  const auto maxPairMass = parentMass - mass;
+  const auto maxWeight = TwoBodyMomentum(parentMass, minPairMass, mass) * TwoBodyMomentum(maxPairMass, mass, mass);
+
+  G4double pairMass;
+  G4double outerMomentum;
+  G4double innerMomentum;
+  do {
+    pairMass = minPairMass + (maxPairMass - minPairMass) * G4RandFlat::shoot();
+    outerMomentum = TwoBodyMomentum(parentMass, pairMass, mass);
+    innerMomentum = TwoBodyMomentum(pairMass, mass, mass);
+  } while (outerMomentum * innerMomentum < maxWeight * G4RandFlat::shoot());
+
+  // parent rest frame: pair recoils against the third neutron
+  const auto outer = IsotropicDirection() * outerMomentum;
+  auto third = G4LorentzVector(-outer, std::sqrt(outerMomentum * outerMomentum + mass * mass));
+  const auto pair = G4LorentzVector(outer, std::sqrt(outerMomentum * outerMomentum + pairMass * pairMass));
+
+  // pair rest frame
+  const auto inner = IsotropicDirection() * innerMomentum;
+  auto first = G4LorentzVector(inner, pairMass / 2);
+  auto second = G4LorentzVector(-inner, pairMass / 2);
+  first.boost(pair.boostVector());
+  second.boost(pair.boostVector());
+
+  first.boost(boost);
+  second.boost(boost);
+  third.boost(boost);
+
+  results.emplace_back(MakeNeutron(first, arena));
+  results.emplace_back(MakeNeutron(second, arena));
+  results.emplace_back(MakeNeutron(third, arena));
+}
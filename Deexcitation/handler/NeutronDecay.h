@@ -0,0 +1,28 @@
+#pragma once
+
+#include <G4Fragment.hh>
+#include <G4FermiPhaseDecay.hh>
+
+#include "FragmentArena.h"
+
+// Phase space decay of pure neutron clusters
+class NeutronDecay {
+ public:
+  NeutronDecay() = default;
+
+  // neutrons are placed in arena if it is given, otherwise on the heap
+  void BreakFragment(G4FragmentVector& results, const G4Fragment& fragment, FragmentArena* arena = nullptr);
+
+  // closed form kernels for A = 2 and A = 3, the general phase space decay is used otherwise
+  void SetFastPaths(bool enable) { fastPaths_ = enable; }
+
+  bool HasFastPaths() const { return fastPaths_; }
+
+ private:
+  static void TwoBodyDecay(G4FragmentVector& results, const G4LorentzVector& momentum, FragmentArena* arena);
+
+  static void ThreeBodyDecay(G4FragmentVector& results, const G4LorentzVector& momentum, FragmentArena* arena);
+
+  G4FermiPhaseDecay phaseSpaceDecay_;
+  bool fastPaths_ = true;
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <G4Types.hh>
+
+// region of the nuclide chart the handler tables are built for, G4NuclearLevelData has no data above Z = 118
+struct NuclideChart {
+  static constexpr G4int MaxZ = 118;
+  static constexpr G4int MaxA = 300;
+};
+
+// inclusive bounds of a nuclide chart region
+struct NuclideRange {
+  G4int minZ;
+  G4int maxZ;
+  G4int minA;
+  G4int maxA;
+};
@@ -0,0 +1,114 @@
+#include <atomic>
+#include <mutex>
+
+#include <G4BosonConstructor.hh>
+#include <G4LeptonConstructor.hh>
+#include <G4MesonConstructor.hh>
+#include <G4BaryonConstructor.hh>
+#include <G4IonConstructor.hh>
+#include <G4GenericIon.hh>
+#include <G4IonTable.hh>
+#include <G4PDefManager.hh>
+#include <G4ParticleDefinition.hh>
+#include <G4ParticleTable.hh>
+#include <G4ProcessManager.hh>
+#include <G4StateManager.hh>
+#include <G4Threading.hh>
+
+#include "ParticleEnvironment.h"
+
+namespace {
+  std::once_flag ParticlesFlag;
+  std::once_flag IonsFlag;
+
+  std::atomic<G4int> NextWorkerId = 0;
+
+  std::mutex SetupTimeMutex;
+  std::chrono::duration<double> SetupTime{};
+
+  template <class F>
+  void Timed(F&& f) {
+    const auto startTime = std::chrono::steady_clock::now();
+    f();
+    std::lock_guard lock(SetupTimeMutex);
+    SetupTime += std::chrono::steady_clock::now() - startTime;
+  }
+
+  void ConstructParticles() {
+    G4BosonConstructor pCBos;
+    pCBos.ConstructParticle();
+
+    G4LeptonConstructor pCLept;
+    pCLept.ConstructParticle();
+
+    G4MesonConstructor pCMes;
+    pCMes.ConstructParticle();
+
+    G4BaryonConstructor pCBar;
+    pCBar.ConstructParticle();
+
+    G4IonConstructor pCIon;
+    pCIon.ConstructParticle();
+
+    G4GenericIon* gion = G4GenericIon::GenericIon();
+    if (gion->GetProcessManager() == nullptr) {
+      auto manager = new G4ProcessManager(gion);
+      manager->SetVerboseLevel(0);
+      gion->SetProcessManager(manager);
+    }
+
+    G4ParticleTable::GetParticleTable()->SetReadiness();
+  }
+
+  void CreateAllIons() {
+    G4IonTable* ionTable = G4ParticleTable::GetParticleTable()->GetIonTable();
+    ionTable->CreateAllIon();
+    ionTable->CreateAllIsomer();
+  }
+} // namespace
+
+void ParticleEnvironment::Initialize(IonTableMode ionTableMode) {
+  // state manager is thread local in multithreaded Geant4 builds
+  thread_local const bool stateSet = [] {
+    return G4StateManager::GetStateManager()->SetNewState(G4State_Init); // To let create ions
+  }();
+  static_cast<void>(stateSet);
+
+  std::call_once(ParticlesFlag, [] { Timed(ConstructParticles); });
+
+  if (ionTableMode == IonTableMode::Eager) {
+    std::call_once(IonsFlag, [] { Timed(CreateAllIons); });
+  }
+}
+
+ParticleEnvironment::WorkerScope::WorkerScope() {
+#ifdef G4MULTITHREADED
+  G4Threading::G4SetThreadId(NextWorkerId++);
+
+  // split class data of particle definitions, process managers among them, is per thread
+  const_cast<G4PDefManager&>(G4ParticleDefinition::GetSubInstanceManager()).NewSubInstances();
+  G4ParticleTable::GetParticleTable()->WorkerG4ParticleTable();
+  G4IonTable::GetIonTable()->WorkerG4IonTable();
+
+  // ions can be created only with the generic ion process manager in place, like on the master
+  const auto manager = new G4ProcessManager(G4GenericIon::GenericIon());
+  manager->SetVerboseLevel(0);
+  G4GenericIon::GenericIon()->SetProcessManager(manager);
+#endif
+}
+
+ParticleEnvironment::WorkerScope::~WorkerScope() {
+#ifdef G4MULTITHREADED
+  delete G4GenericIon::GenericIon()->GetProcessManager();
+  G4GenericIon::GenericIon()->SetProcessManager(nullptr);
+
+  G4IonTable::GetIonTable()->DestroyWorkerG4IonTable();
+  G4ParticleTable::GetParticleTable()->DestroyWorkerG4ParticleTable();
+  const_cast<G4PDefManager&>(G4ParticleDefinition::GetSubInstanceManager()).FreeSlave();
+#endif
+}
+
+std::chrono::duration<double> ParticleEnvironment::GetSetupTime() {
+  std::lock_guard lock(SetupTimeMutex);
+  return SetupTime;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <chrono>
+
+#include "IonTableMode.h"
+
+// Process-wide Geant4 particle and ion tables shared by all handlers.
+// Every step runs once per process, whichever thread asks first.
+class ParticleEnvironment {
+ public:
+  // particles and generic ion process manager, G4State_Init once per thread,
+  // in eager mode all ions and isomers are created as well
+  static void Initialize(IonTableMode ionTableMode);
+
+  // wall time spent in the one-time steps so far
+  static std::chrono::duration<double> GetSetupTime();
+
+  // Registers the current thread as a Geant4 worker for its lifetime: particle and ion tables get thread-local
+  // copies of the master ones, and ions created here go through the master table.
+  // Master particles must be constructed before, handlers of the thread must be destroyed before it.
+  class WorkerScope {
+   public:
+    WorkerScope();
+
+    WorkerScope(const WorkerScope&) = delete;
+
+    ~WorkerScope();
+
+    WorkerScope& operator=(const WorkerScope&) = delete;
+  };
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Structure of arrays output of the handler, the i-th product is the i-th element of every column.
+// Columns keep their capacity on Clear, so a reused buffer doesn't allocate in steady state.
+template <class Real>
+struct BasicProductColumns {
+  std::vector<std::int32_t> pdg;
+  std::vector<std::int32_t> A;
+  std::vector<std::int32_t> Z;
+  std::vector<Real> px;
+  std::vector<Real> py;
+  std::vector<Real> pz;
+  std::vector<Real> e;
+  std::vector<Real> t;  // formation time
+
+  size_t Size() const { return pdg.size(); }
+
+  void Clear() {
+    pdg.clear();
+    A.clear();
+    Z.clear();
+    px.clear();
+    py.clear();
+    pz.clear();
+    e.clear();
+    t.clear();
+  }
+
+  void Reserve(size_t size) {
+    pdg.reserve(size);
+    A.reserve(size);
+    Z.reserve(size);
+    px.reserve(size);
+    py.reserve(size);
+    pz.reserve(size);
+    e.reserve(size);
+    t.reserve(size);
+  }
+};
+
+using ProductColumns = BasicProductColumns<double>;
+
+// halves the momentum columns, precision is enough for analysis
+using ProductColumnsF = BasicProductColumns<float>;
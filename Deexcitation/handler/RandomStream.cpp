@@ -0,0 +1,37 @@
+#include <CLHEP/Random/RandGauss.h>
+#include <Randomize.hh>
+
+#include "RandomStream.h"
+
+namespace {
+  // splitmix64 finalizer, spreads close counters over the whole seed space
+  std::uint64_t Mix(std::uint64_t value) {
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+  }
+
+  // MixMax seeds are 32 bit wide
+  long Low(std::uint64_t value) { return static_cast<long>(value & 0xffffffffULL); }
+
+  long High(std::uint64_t value) { return static_cast<long>(value >> 32); }
+} // namespace
+
+RandomStream::Scope::~Scope() {
+  G4Random::setTheEngine(previous_);
+}
+
+RandomStream::Scope RandomStream::Enter(std::uint64_t eventId, std::uint64_t fragmentIdx) {
+  const auto eventKey = Mix(runSeed_ ^ Mix(eventId));
+  const auto fragmentKey = Mix(eventKey ^ Mix(fragmentIdx));
+  const long seeds[] = {Low(eventKey), High(eventKey), Low(fragmentKey), High(fragmentKey), 0};
+  engine_.setSeeds(seeds, 4);
+
+  // cached gaussian of the previous stream must not leak into this one
+  CLHEP::RandGauss::setFlag(false);
+
+  auto previous = G4Random::getTheEngine();
+  G4Random::setTheEngine(&engine_);
+  return Scope(previous);
+}
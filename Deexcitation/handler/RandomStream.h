@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+#include <CLHEP/Random/MixMaxRng.h>
+
+// Counter based random streams: the engine is reseeded from (run seed, event id, fragment index),
+// so a fragment draws the same numbers regardless of the thread or order it is processed in.
+class RandomStream {
+ public:
+  explicit RandomStream(std::uint64_t runSeed) : runSeed_(runSeed) {}
+
+  std::uint64_t GetRunSeed() const { return runSeed_; }
+
+  // installs the stream of the fragment as the thread's engine, until the returned guard is destroyed
+  class Scope {
+   public:
+    Scope(const Scope&) = delete;
+
+    Scope& operator=(const Scope&) = delete;
+
+    ~Scope();
+
+   private:
+    friend class RandomStream;
+
+    explicit Scope(CLHEP::HepRandomEngine* previous) : previous_(previous) {}
+
+    CLHEP::HepRandomEngine* previous_;
+  };
+
+  Scope Enter(std::uint64_t eventId, std::uint64_t fragmentIdx);
+
+ private:
+  std::uint64_t runSeed_;
+  CLHEP::MixMaxRng engine_;
+};
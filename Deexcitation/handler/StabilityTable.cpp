@@ -0,0 +1,17 @@
+#include <G4NistManager.hh>
+
+#include "StabilityTable.h"
+
+const StabilityTable& StabilityTable::Instance() {
+  static const StabilityTable table;
+  return table;
+}
+
+StabilityTable::StabilityTable() {
+  const auto nist = G4NistManager::Instance();
+  for (G4int Z = 1; Z <= MaxZ; ++Z) {
+    for (G4int A = Z; A <= MaxA; ++A) {
+      stable_[Index(Z, A)] = nist->GetIsotopeAbundance(Z, A) > 0;
+    }
+  }
+}
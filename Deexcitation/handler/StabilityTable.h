@@ -0,0 +1,32 @@
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+
+#include <G4Types.hh>
+
+#include "NuclideRange.h"
+
+// Nuclides with natural abundance over the whole nuclide chart.
+// Built once from NIST data, a lookup is a single bit test.
+class StabilityTable {
+ public:
+  static constexpr G4int MaxZ = NuclideChart::MaxZ;
+  static constexpr G4int MaxA = NuclideChart::MaxA;
+
+  static const StabilityTable& Instance();
+
+  bool IsStable(G4int Z, G4int A) const {
+    if (Z < 0 || Z > MaxZ || A < 0 || A > MaxA) {
+      return false;
+    }
+    return stable_[Index(Z, A)];
+  }
+
+ private:
+  StabilityTable();
+
+  static constexpr size_t Index(G4int Z, G4int A) { return static_cast<size_t>(Z) * (MaxA + 1) + A; }
+
+  std::bitset<(MaxZ + 1) * (MaxA + 1)> stable_;
+};
@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+
+#include <benchmark/benchmark.h>
+#include <COLA.hh>
+#include <CLHEP/Units/PhysicalConstants.h>
+#include <G4NucleiProperties.hh>
+
+#include "Deexcitation/handler/ExcitationHandler.h"
+#include "Deexcitation/G4HandlerConverter.h"
+
+namespace {
+  // spectators of both nuclei plus produced nucleons, as a collision generator would emit them
+  cola::EventData SyntheticEvent(size_t spectators, G4double energyPerNucleon) {
+    std::mt19937 rng(spectators);
+    std::uniform_int_distribution<int> massDistribution(1, 100);
+
+    cola::EventData event;
+    for (size_t i = 0; i < spectators; ++i) {
+      const auto A = massDistribution(rng);
+      const auto Z = std::uniform_int_distribution<int>(0, A / 2)(rng);
+      const auto mass = Z == 0 ? A * CLHEP::neutron_mass_c2 : G4NucleiProperties::GetNuclearMass(A, Z);
+      event.particles.push_back(cola::Particle{
+        .position=cola::LorentzVector{},
+        .momentum=cola::LorentzVector{.e=mass + energyPerNucleon * A, .x=0., .y=0., .z=0.},
+        .pdgCode=cola::AZToPdg({A, Z}),
+        .pClass=i % 2 == 0 ? cola::ParticleClass::spectatorA : cola::ParticleClass::spectatorB,
+      });
+      event.particles.push_back(cola::Particle{
+        .position=cola::LorentzVector{},
+        .momentum=cola::LorentzVector{.e=CLHEP::proton_mass_c2, .x=0., .y=0., .z=0.},
+        .pdgCode=cola::AZToPdg({1, 1}),
+        .pClass=cola::ParticleClass::produced,
+      });
+    }
+    return event;
+  }
+
+  // args are spectators per event, E*/A in keV and whether stage batched mode is used,
+  // cache misses of both modes are compared with --benchmark_perf_counters=CACHE-MISSES
+  void BM_G4HandlerConverter(benchmark::State& state) {
+    static cola::G4HandlerConverter converter(std::make_unique<ExcitationHandler>());
+    converter.SetStaged(state.range(2) != 0);
+    const auto event = SyntheticEvent(state.range(0), state.range(1) * CLHEP::keV);
+    // non-spectators are copied to the output as they are, they don't reach the handler
+    const auto passThrough = static_cast<size_t>(std::count_if(
+        event.particles.begin(), event.particles.end(), [](const cola::Particle& particle) {
+          return particle.pClass != cola::ParticleClass::spectatorA && particle.pClass != cola::ParticleClass::spectatorB;
+        }));
+
+    size_t products = 0;
+    for (auto _ : state) {
+      // event copy is part of the measurement, it is small compared to the de-excitation
+      auto result = converter(std::make_unique<cola::EventData>(event));
+      products += result->particles.size() - passThrough;
+      benchmark::DoNotOptimize(result.get());
+    }
+    const auto iterations = static_cast<double>(state.iterations());
+    state.counters["events/s"] = benchmark::Counter(iterations, benchmark::Counter::kIsRate);
+    state.counters["products/s"] = benchmark::Counter(static_cast<double>(products), benchmark::Counter::kIsRate);
+    state.counters["passThrough/s"] = benchmark::Counter(iterations * static_cast<double>(passThrough),
+                                                         benchmark::Counter::kIsRate);
+  }
+} // namespace
+
+BENCHMARK(BM_G4HandlerConverter)
+    ->ArgNames({"spectators", "ExPerA_keV", "staged"})
+    ->ArgsProduct({{2, 8, 32}, {1000, 5000}, {0, 1}});
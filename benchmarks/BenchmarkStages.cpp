@@ -0,0 +1,158 @@
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <CLHEP/Units/PhysicalConstants.h>
+#include <G4NucleiProperties.hh>
+
+#include "Deexcitation/handler/ExcitationHandler.h"
+
+#include "Grid.h"
+
+namespace {
+  // exposes single stages, every call starts and ends with clean scratch buffers
+  class StageHandler : public ExcitationHandler {
+   public:
+    size_t MultiFragmentation(const G4Fragment& fragment) {
+      ApplyMultiFragmentation(MakeFragment(fragment), results_, evaporationQueue_);
+      return Collect();
+    }
+
+    size_t FermiBreakUp(const G4Fragment& fragment) {
+      ApplyFermiBreakUp(MakeFragment(fragment), results_, photonEvaporationQueue_);
+      return Collect();
+    }
+
+    size_t Evaporation(const G4Fragment& fragment) {
+      ApplyEvaporation(MakeFragment(fragment), results_, evaporationQueue_);
+      return Collect();
+    }
+
+    size_t PhotonEvaporation(const G4Fragment& fragment) {
+      ApplyPhotonEvaporation(MakeFragment(fragment), results_);
+      return Collect();
+    }
+
+    size_t NeutronDecay(const G4Fragment& fragment) {
+      ApplyPureNeutronDecay(MakeFragment(fragment), results_);
+      return Collect();
+    }
+
+    // de-excited products of the fragment are kept for Convert
+    void Prepare(const G4Fragment& fragment) {
+      ClearScratch();
+      Deexcite(fragment);
+    }
+
+    size_t Convert(std::vector<G4ReactionProduct>& products) {
+      products.clear();
+      ConvertResults(results_, products);
+      return products.size();
+    }
+
+   private:
+    size_t Collect() {
+      const auto count = results_.size() + evaporationQueue_.Size() + photonEvaporationQueue_.Size();
+      ClearScratch();
+      return count;
+    }
+  };
+
+  StageHandler& Handler() {
+    static StageHandler handler;
+    return handler;
+  }
+
+  // stages run only on nuclides their default routing condition sends to them
+  void FermiBreakUpGrid(benchmark::internal::Benchmark* benchmark) {
+    grid::NuclidesIf(benchmark, "DEEXCITATION_BENCH_FERMI_NUCLIDES", "4:2,6:3,9:4,12:6,16:8", [](long A, long Z) {
+      const auto condition = DefaultConditions::FermiBreakUp{};
+      return A < condition.maxAtomicMass && Z < condition.maxCharge;
+    });
+  }
+
+  void MultiFragmentationGrid(benchmark::internal::Benchmark* benchmark) {
+    grid::NuclidesIf(benchmark, "DEEXCITATION_BENCH_NUCLIDES", "12:6,40:20,100:44,200:80", [](long A, long Z) {
+      const auto condition = DefaultConditions::MultiFragmentation{};
+      return A >= condition.maxAtomicMass || Z >= condition.maxCharge;
+    });
+  }
+
+  G4Fragment GridFragment(const benchmark::State& state) {
+    const auto A = static_cast<G4int>(state.range(0));
+    const auto Z = static_cast<G4int>(state.range(1));
+    const auto energy = static_cast<G4double>(state.range(2)) * CLHEP::keV * A;
+    const auto mass = Z == 0 ? A * CLHEP::neutron_mass_c2 : G4NucleiProperties::GetNuclearMass(A, Z);
+    return G4Fragment(A, Z, G4LorentzVector(0, 0, 0, mass + energy));
+  }
+
+  void SetRates(benchmark::State& state, size_t products) {
+    state.counters["breakups/s"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+    state.counters["products/s"] = benchmark::Counter(static_cast<double>(products), benchmark::Counter::kIsRate);
+  }
+
+  void RunStage(benchmark::State& state, size_t (StageHandler::*stage)(const G4Fragment&)) {
+    auto& handler = Handler();
+    const auto fragment = GridFragment(state);
+
+    size_t products = 0;
+    for (auto _ : state) {
+      products += (handler.*stage)(fragment);
+    }
+    SetRates(state, products);
+  }
+
+  void BM_MultiFragmentation(benchmark::State& state) { RunStage(state, &StageHandler::MultiFragmentation); }
+
+  void BM_FermiBreakUp(benchmark::State& state) { RunStage(state, &StageHandler::FermiBreakUp); }
+
+  void BM_Evaporation(benchmark::State& state) { RunStage(state, &StageHandler::Evaporation); }
+
+  void BM_PhotonEvaporation(benchmark::State& state) { RunStage(state, &StageHandler::PhotonEvaporation); }
+
+  void BM_NeutronDecay(benchmark::State& state) { RunStage(state, &StageHandler::NeutronDecay); }
+
+  // general phase space decay for the same clusters, to compare with the closed form kernels
+  void BM_NeutronDecayGeneral(benchmark::State& state) {
+    auto& neutronDecay = Handler().GetNeutronDecay();
+    neutronDecay->SetFastPaths(false);
+    RunStage(state, &StageHandler::NeutronDecay);
+    neutronDecay->SetFastPaths(true);
+  }
+
+  void BM_ConvertResults(benchmark::State& state) {
+    auto& handler = Handler();
+    handler.Prepare(GridFragment(state));
+
+    std::vector<G4ReactionProduct> products;
+    size_t count = 0;
+    for (auto _ : state) {
+      count += handler.Convert(products);
+      benchmark::DoNotOptimize(products.data());
+    }
+    SetRates(state, count);
+  }
+
+  void BM_BreakItUp(benchmark::State& state) {
+    auto& handler = Handler();
+    const auto fragment = GridFragment(state);
+
+    std::vector<G4ReactionProduct> products;
+    size_t count = 0;
+    for (auto _ : state) {
+      products.clear();
+      handler.BreakItUp(fragment, products);
+      count += products.size();
+      benchmark::DoNotOptimize(products.data());
+    }
+    SetRates(state, count);
+  }
+} // namespace
+
+BENCHMARK(BM_MultiFragmentation)->Apply(MultiFragmentationGrid);
+BENCHMARK(BM_FermiBreakUp)->Apply(FermiBreakUpGrid);
+BENCHMARK(BM_Evaporation)->Apply(grid::Nuclides);
+BENCHMARK(BM_PhotonEvaporation)->Apply(grid::Nuclides);
+BENCHMARK(BM_NeutronDecay)->Apply(grid::Neutrons);
+BENCHMARK(BM_NeutronDecayGeneral)->Apply(grid::Neutrons);
+BENCHMARK(BM_ConvertResults)->Apply(grid::Nuclides);
+BENCHMARK(BM_BreakItUp)->Apply(grid::Nuclides);
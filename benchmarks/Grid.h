@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+// Benchmark grid, overridden through the environment:
+//   DEEXCITATION_BENCH_NUCLIDES="A:Z,A:Z,..." (default "12:6,40:20,100:44,200:80")
+//   DEEXCITATION_BENCH_ENERGIES="E,E,..."      excitation energy per nucleon in MeV (default "1,3,5,8")
+//   DEEXCITATION_BENCH_FERMI_NUCLIDES="A:Z,..." light nuclides for Fermi break-up (default "4:2,6:3,9:4,12:6,16:8")
+namespace grid {
+  inline std::vector<std::string> Split(const std::string& value, char delimiter) {
+    std::vector<std::string> items;
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, delimiter)) {
+      if (!item.empty()) {
+        items.push_back(item);
+      }
+    }
+    return items;
+  }
+
+  inline std::string FromEnv(const char* name, const char* fallback) {
+    const auto value = std::getenv(name);
+    return value != nullptr ? value : fallback;
+  }
+
+  // args are A, Z and E*/A in keV, only nuclides accepted by filter(A, Z) are added
+  template <class Filter>
+  void NuclidesIf(benchmark::internal::Benchmark* benchmark, const char* variable, const char* fallback, Filter filter) {
+    benchmark->ArgNames({"A", "Z", "ExPerA_keV"});
+    const auto nuclides = Split(FromEnv(variable, fallback), ',');
+    const auto energies = Split(FromEnv("DEEXCITATION_BENCH_ENERGIES", "1,3,5,8"), ',');
+    for (const auto& nuclide : nuclides) {
+      const auto colon = nuclide.find(':');
+      const auto A = std::stol(nuclide.substr(0, colon));
+      const auto Z = std::stol(nuclide.substr(colon + 1));
+      if (!filter(A, Z)) {
+        continue;
+      }
+      for (const auto& energy : energies) {
+        benchmark->Args({A, Z, static_cast<long>(std::stod(energy) * 1000)});
+      }
+    }
+  }
+
+  inline void Nuclides(benchmark::internal::Benchmark* benchmark) {
+    NuclidesIf(benchmark, "DEEXCITATION_BENCH_NUCLIDES", "12:6,40:20,100:44,200:80", [](long, long) { return true; });
+  }
+
+  // pure neutron clusters, Z is always zero
+  inline void Neutrons(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"A", "Z", "ExPerA_keV"});
+    for (const long A : {2, 3, 4, 8}) {
+      benchmark->Args({A, 0, 100});
+    }
+  }
+} // namespace grid
@@ -1,62 +1,250 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
 #include <COLA.hh>
 #include <CLHEP/Units/PhysicalConstants.h>
+#include <G4NucleiProperties.hh>
 
-#include "Deexcitation/handler/ExcitationHandler.h"
 #include "Deexcitation/DeexcitationModule.h"
 
-class TestGenerator: public cola::VGenerator {
-public:
-  TestGenerator(const cola::EventParticles& particles) : particles_(particles) {}
+namespace {
+  using Clock = std::chrono::steady_clock;
+
+  struct Nuclide {
+    int A;
+    int Z;
+  };
+
+  struct Workload {
+    size_t events = 1000;
+    size_t spectators = 2;
+    std::vector<Nuclide> nuclides = {{56, 26}, {197, 79}};
+    double minEnergy = 1. * CLHEP::MeV;  // per nucleon
+    double maxEnergy = 5. * CLHEP::MeV;
+    std::uint64_t seed = 1;
+    std::string config = "config.xml";
+    std::map<std::string, std::string> pipeline;  // G4HandlerFactory parameters, empty means COLA run manager
+  };
+
+  // per-event latency is measured from generation to writing
+  struct Timing {
+    std::vector<Clock::time_point> starts;
+    std::vector<double> latencies;  // seconds
+    size_t products = 0;
+  };
+
+  class WorkloadGenerator : public cola::VGenerator {
+  public:
+    WorkloadGenerator(const Workload& workload, Timing& timing)
+      : workload_(workload), timing_(timing), rng_(workload.seed) {}
+
+    std::unique_ptr<cola::EventData> operator()() override {
+      std::uniform_int_distribution<size_t> nuclideDistribution(0, workload_.nuclides.size() - 1);
+      std::uniform_real_distribution<double> energyDistribution(workload_.minEnergy, workload_.maxEnergy);
+
+      auto data = std::make_unique<cola::EventData>();
+      for (size_t i = 0; i < workload_.spectators; ++i) {
+        const auto [A, Z] = workload_.nuclides[nuclideDistribution(rng_)];
+        const auto mass = G4NucleiProperties::GetNuclearMass(A, Z);
+        data->particles.push_back(cola::Particle{
+          .position=cola::LorentzVector{},
+          .momentum=cola::LorentzVector{.e=mass + energyDistribution(rng_) * A, .x=0., .y=0., .z=0.},
+          .pdgCode=cola::AZToPdg({A, Z}),
+          .pClass=i % 2 == 0 ? cola::ParticleClass::spectatorA : cola::ParticleClass::spectatorB,
+        });
+      }
+
+      timing_.starts.push_back(Clock::now());
+      return data;
+    }
+
+  private:
+    const Workload& workload_;
+    Timing& timing_;
+    std::mt19937_64 rng_;
+  };
+
+  // events are counted and dropped, so memory reflects the converter only
+  class CountingWriter : public cola::VWriter {
+  public:
+    CountingWriter(Timing& timing) : timing_(timing) {}
+
+    void operator()(std::unique_ptr<cola::EventData>&& event) override {
+      const auto idx = timing_.latencies.size();
+      timing_.latencies.push_back(std::chrono::duration<double>(Clock::now() - timing_.starts[idx]).count());
+      timing_.products += event->particles.size();
+    }
+
+  private:
+    Timing& timing_;
+  };
 
-  std::unique_ptr<cola::EventData> operator()() override {
-    auto data = std::make_unique<cola::EventData>();
-    data->particles = particles_;
+  class WorkloadGeneratorFactory : public cola::VFactory {
+  public:
+    WorkloadGeneratorFactory(const Workload& workload, Timing& timing) : workload_(workload), timing_(timing) {}
 
-    return data;
+    cola::VFilter* create(const std::map<std::string, std::string>&) override {
+      return new WorkloadGenerator(workload_, timing_);
+    }
+
+  private:
+    const Workload& workload_;
+    Timing& timing_;
+  };
+
+  class CountingWriterFactory : public cola::VFactory {
+  public:
+    CountingWriterFactory(Timing& timing) : timing_(timing) {}
+
+    cola::VFilter* create(const std::map<std::string, std::string>&) override {
+      return new CountingWriter(timing_);
+    }
+
+  private:
+    Timing& timing_;
+  };
+
+  std::vector<Nuclide> ParseNuclides(const std::string& value) {
+    std::vector<Nuclide> nuclides;
+    std::stringstream ss(value);
+    std::string entry;
+    while (std::getline(ss, entry, ',')) {
+      const auto colon = entry.find(':');
+      if (colon == std::string::npos) {
+        throw std::runtime_error("nuclide must look like A:Z, but got: " + entry);
+      }
+      nuclides.push_back({std::stoi(entry.substr(0, colon)), std::stoi(entry.substr(colon + 1))});
+    }
+    if (nuclides.empty()) {
+      throw std::runtime_error("at least one nuclide is required");
+    }
+    return nuclides;
   }
 
-private:
-  const cola::EventParticles particles_;
-};
+  // "key=value;key=value", semicolons because range parameters contain commas
+  std::map<std::string, std::string> ParseParams(const std::string& value) {
+    std::map<std::string, std::string> params;
+    std::stringstream ss(value);
+    std::string entry;
+    while (std::getline(ss, entry, ';')) {
+      const auto equals = entry.find('=');
+      if (equals == std::string::npos) {
+        throw std::runtime_error("parameter must look like key=value, but got: " + entry);
+      }
+      params[entry.substr(0, equals)] = entry.substr(equals + 1);
+    }
+    return params;
+  }
 
-class TestGeneratorFactory: public cola::VFactory {
-public:
-  cola::VFilter* create(const std::map<std::string, std::string>&) override {
-    return new TestGenerator(particles);
+  void PrintUsage() {
+    std::cout << "Runner [options]\n"
+              << "  --events N            events to process (1000)\n"
+              << "  --spectators N        spectators per event (2)\n"
+              << "  --nuclides A:Z,...    spectator nuclides, picked uniformly (56:26,197:79)\n"
+              << "  --energy MIN-MAX      excitation energy per nucleon in MeV (1-5)\n"
+              << "  --seed N              workload seed (1)\n"
+              << "  --config PATH         COLA config, converter parameters and threads live there (config.xml)\n"
+              << "  --pipeline PARAMS     run through G4HandlerPipeline instead of the COLA run manager,\n"
+              << "                        PARAMS are factory parameters, e.g. streamSeed=1;pipelineThreads=4\n";
   }
 
-  cola::EventParticles particles;
-};
+  Workload ParseArgs(int argc, char** argv) {
+    Workload workload;
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      if (arg == "--help" || arg == "-h") {
+        PrintUsage();
+        std::exit(0);
+      }
+      if (i + 1 == argc) {
+        throw std::runtime_error("missing value for " + arg);
+      }
+      const std::string value = argv[++i];
 
-class TestWriter: public cola::VWriter {
-public:
-  TestWriter(std::vector<std::unique_ptr<cola::EventData>>& holder) : events_(holder) {}
+      if (arg == "--events") {
+        workload.events = std::stoul(value);
+      } else if (arg == "--spectators") {
+        workload.spectators = std::stoul(value);
+      } else if (arg == "--nuclides") {
+        workload.nuclides = ParseNuclides(value);
+      } else if (arg == "--energy") {
+        const auto dash = value.find('-');
+        workload.minEnergy = std::stod(value.substr(0, dash)) * CLHEP::MeV;
+        workload.maxEnergy = dash == std::string::npos ? workload.minEnergy : std::stod(value.substr(dash + 1)) * CLHEP::MeV;
+      } else if (arg == "--seed") {
+        workload.seed = std::stoull(value);
+      } else if (arg == "--config") {
+        workload.config = value;
+      } else if (arg == "--pipeline") {
+        workload.pipeline = ParseParams(value);
+      } else {
+        throw std::runtime_error("unknown option: " + arg);
+      }
+    }
+    return workload;
+  }
+
+  double Percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) {
+      return 0;
+    }
+    const auto idx = static_cast<size_t>(fraction * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + idx, values.end());
+    return values[idx];
+  }
 
-  void operator()(std::unique_ptr<cola::EventData>&& event) {
-    events_.emplace_back(std::move(event));
+  long PeakRssKb() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
   }
+} // namespace
+
+int main(int argc, char** argv) {
+  const auto workload = ParseArgs(argc, argv);
+  Timing timing;
+  timing.starts.reserve(workload.events);
+  timing.latencies.reserve(workload.events);
+
+  // handler startup isn't part of the throughput
+  double elapsed = 0;
+  if (workload.pipeline.empty()) {
+    cola::MetaProcessor metaProcessor;
+    metaProcessor.reg(std::make_unique<WorkloadGeneratorFactory>(workload, timing), "generator", cola::FilterType::generator);
+    metaProcessor.reg(std::make_unique<cola::G4HandlerFactory>(), "converter", cola::FilterType::converter);
+    metaProcessor.reg(std::make_unique<CountingWriterFactory>(timing), "writer", cola::FilterType::writer);
+
+    auto manager = cola::ColaRunManager(metaProcessor.parse(workload.config));
 
-private:
-  std::vector<std::unique_ptr<cola::EventData>>& events_;
-};
+    const auto startTime = Clock::now();
+    manager.run(static_cast<int>(workload.events));
+    elapsed = std::chrono::duration<double>(Clock::now() - startTime).count();
+  } else {
+    auto pipeline = cola::G4HandlerFactory::CreatePipeline(workload.pipeline);
+    auto generator = WorkloadGenerator(workload, timing);
+    auto writer = CountingWriter(timing);
 
-class TestWriterFactory: public cola::VFactory {
-public:
-  cola::VFilter* create(const std::map<std::string, std::string>&) override {
-    return new TestWriter(events);
+    const auto startTime = Clock::now();
+    pipeline->Run(generator, writer, workload.events);
+    elapsed = std::chrono::duration<double>(Clock::now() - startTime).count();
   }
 
-  std::vector<std::unique_ptr<cola::EventData>> events;
-};
-
-int main() {
-  cola::MetaProcessor metaProcessor;
-  TestGeneratorFactory* genFactory = new TestGeneratorFactory();
-  TestWriterFactory* writerFactory = new TestWriterFactory();
-  auto converter = new cola::FermiFactory();
-  metaProcessor.reg(std::unique_ptr<cola::VFactory>(genFactory), "generator", cola::FilterType::generator);
-  metaProcessor.reg(std::unique_ptr<cola::VFactory>(converter), "converter", cola::FilterType::converter);
-  metaProcessor.reg(std::unique_ptr<cola::VFactory>(writerFactory), "writer", cola::FilterType::writer);
-  auto manager = cola::ColaRunManager(metaProcessor.parse("config.xml"));
-  manager.run(1);
+  std::cout << "events:        " << timing.latencies.size() << '\n'
+            << "elapsed [s]:   " << elapsed << '\n'
+            << "events/s:      " << timing.latencies.size() / elapsed << '\n'
+            << "products/s:    " << timing.products / elapsed << '\n'
+            << "p50 [ms]:      " << Percentile(timing.latencies, 0.5) * 1e3 << '\n'
+            << "p99 [ms]:      " << Percentile(timing.latencies, 0.99) * 1e3 << '\n'
+            << "peak RSS [MB]: " << PeakRssKb() / 1024. << std::endl;
 }
@@ -1,8 +1,17 @@
 #include <COLA.hh>
 #include <gtest/gtest.h>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
 #include <CLHEP/Units/PhysicalConstants.h>
+#include <G4NucleiProperties.hh>
 
 #include "Deexcitation/DeexcitationModule.h"
+#include "Deexcitation/handler/ExcitationHandler.h"
 
 namespace {
 
@@ -75,6 +84,73 @@ namespace {
           && a.pClass == b.pClass;
   }
 
+  std::unique_ptr<cola::EventData> SpectatorsEvent() {
+    auto event = std::make_unique<cola::EventData>();
+    const int nuclides[][2] = {{12, 6}, {40, 20}, {56, 26}, {90, 40}, {16, 8}, {27, 13}, {64, 29}, {4, 2}};
+    for (const auto& [A, Z] : nuclides) {
+      event->particles.push_back(cola::Particle{
+        .position=cola::LorentzVector{},
+        .momentum=cola::LorentzVector{
+          .e=G4NucleiProperties::GetNuclearMass(A, Z) + 4 * CLHEP::MeV * A,
+          .x=0.,
+          .y=0.,
+          .z=0.,
+        },
+        .pdgCode=cola::AZToPdg({A, Z}),
+        .pClass=event->particles.size() % 2 == 0 ? cola::ParticleClass::spectatorA : cola::ParticleClass::spectatorB,
+      });
+    }
+    return event;
+  }
+
+  template <class T>
+  std::vector<T> ReadColumn(std::ifstream& in, size_t size) {
+    auto column = std::vector<T>(size);
+    in.read(reinterpret_cast<char*>(column.data()), static_cast<std::streamsize>(size * sizeof(T)));
+    if (const auto tail = size * sizeof(T) % 8; tail != 0) {
+      in.ignore(static_cast<std::streamsize>(8 - tail));
+    }
+    return column;
+  }
+
+  // reads every chunk of a columnar file back into events
+  std::vector<cola::EventParticles> ReadColumnar(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(cola::ColumnarWriter::Magic)];
+    in.read(magic, sizeof(magic));
+    EXPECT_EQ(std::memcmp(magic, cola::ColumnarWriter::Magic, sizeof(magic)), 0);
+
+    std::vector<cola::EventParticles> events;
+    std::uint64_t eventsCount = 0;
+    while (in.read(reinterpret_cast<char*>(&eventsCount), sizeof(eventsCount))) {
+      std::uint64_t particlesCount = 0;
+      in.read(reinterpret_cast<char*>(&particlesCount), sizeof(particlesCount));
+      const auto offsets = ReadColumn<std::uint64_t>(in, eventsCount + 1);
+      const auto pdg = ReadColumn<std::int32_t>(in, particlesCount);
+      const auto px = ReadColumn<double>(in, particlesCount);
+      const auto py = ReadColumn<double>(in, particlesCount);
+      const auto pz = ReadColumn<double>(in, particlesCount);
+      const auto e = ReadColumn<double>(in, particlesCount);
+      const auto pClass = ReadColumn<std::uint8_t>(in, particlesCount);
+      EXPECT_TRUE(in);
+      EXPECT_EQ(offsets.front(), 0);
+      EXPECT_EQ(offsets.back(), particlesCount);
+
+      for (size_t i = 0; i < eventsCount; ++i) {
+        auto& particles = events.emplace_back();
+        for (auto j = offsets[i]; j < offsets[i + 1]; ++j) {
+          particles.push_back(cola::Particle{
+            .position=cola::LorentzVector{},
+            .momentum=cola::LorentzVector{.e=e[j], .x=px[j], .y=py[j], .z=pz[j]},
+            .pdgCode=pdg[j],
+            .pClass=static_cast<cola::ParticleClass>(pClass[j]),
+          });
+        }
+      }
+    }
+    return events;
+  }
+
 } // anonymous namespace
 
 TEST(TestModule, TestFermi) {
@@ -173,3 +249,202 @@ TEST(TestModule, TestG4Handler) {
     EXPECT_EQ(events[0]->particles.size(), 2);
   }
 }
+
+TEST(TestModule, ThreadsRequireStreamSeed) {
+  auto factory = cola::G4HandlerFactory();
+  EXPECT_THROW(factory.create({{"threads", "4"}}), std::runtime_error);
+}
+
+TEST(TestModule, ParallelEvaporationRequiresStreamSeed) {
+  auto factory = cola::G4HandlerFactory();
+  EXPECT_THROW(factory.create({{"parallelEvaporationThreads", "4"}}), std::runtime_error);
+}
+
+TEST(TestModule, BudgetRequiresLimit) {
+  auto factory = cola::G4HandlerFactory();
+  EXPECT_THROW(factory.create({{"budgetIterations", "0"}}), std::runtime_error);
+  EXPECT_THROW(factory.create({{"budgetIterations", "0"}, {"budgetTimeMs", "0"}}), std::runtime_error);
+}
+
+TEST(TestModule, StatsDumpedOnDestruction) {
+  auto factory = cola::G4HandlerFactory();
+  auto converter = std::unique_ptr<cola::VFilter>(factory.create({{"stats", "true"}}));
+  dynamic_cast<cola::VConverter&>(*converter)(SpectatorsEvent());
+
+  testing::internal::CaptureStdout();
+  converter.reset();
+  const auto output = testing::internal::GetCapturedStdout();
+
+  EXPECT_NE(output.find("G4HandlerConverter stats"), std::string::npos);
+  EXPECT_NE(output.find("Evaporation"), std::string::npos);
+  EXPECT_NE(output.find("budget fallbacks: 0"), std::string::npos);
+}
+
+TEST(TestModule, WarmUpKeepsOutput) {
+  auto factory = cola::G4HandlerFactory();
+  auto cold = std::unique_ptr<cola::VFilter>(factory.create({{"streamSeed", "42"}}));
+  auto warm = std::unique_ptr<cola::VFilter>(factory.create({{"streamSeed", "42"}, {"warmUp", "1-30:1-70"}}));
+  auto& coldConverter = dynamic_cast<cola::VConverter&>(*cold);
+  auto& warmConverter = dynamic_cast<cola::VConverter&>(*warm);
+
+  const size_t events = 3;
+  for (size_t i = 0; i < events; ++i) {
+    const auto expected = coldConverter(SpectatorsEvent());
+    const auto result = warmConverter(SpectatorsEvent());
+
+    ASSERT_EQ(result->particles.size(), expected->particles.size()) << "event " << i;
+    for (size_t j = 0; j < expected->particles.size(); ++j) {
+      EXPECT_TRUE(result->particles[j] == expected->particles[j]) << "event " << i << ", particle " << j;
+    }
+  }
+}
+
+#ifdef G4MULTITHREADED
+TEST(TestModule, ThreadsMatchSerial) {
+  auto factory = cola::G4HandlerFactory();
+  auto serial = std::unique_ptr<cola::VFilter>(factory.create({{"streamSeed", "42"}}));
+  auto parallel = std::unique_ptr<cola::VFilter>(factory.create({{"streamSeed", "42"}, {"threads", "4"}}));
+  auto& serialConverter = dynamic_cast<cola::VConverter&>(*serial);
+  auto& parallelConverter = dynamic_cast<cola::VConverter&>(*parallel);
+
+  const size_t events = 5;
+  for (size_t i = 0; i < events; ++i) {
+    const auto expected = serialConverter(SpectatorsEvent());
+    const auto result = parallelConverter(SpectatorsEvent());
+
+    ASSERT_EQ(result->particles.size(), expected->particles.size()) << "event " << i;
+    for (size_t j = 0; j < expected->particles.size(); ++j) {
+      EXPECT_TRUE(result->particles[j] == expected->particles[j]) << "event " << i << ", particle " << j;
+    }
+  }
+}
+
+TEST(TestModule, ThreadsWithIonWarmUp) {
+  // workers create ions in prewarm, warm-up and conversion, so their tables have to be set up as Geant4 workers
+  const std::map<std::string, std::string> params = {
+    {"streamSeed", "42"}, {"ionTable", "lazy"}, {"prewarmIons", "1-30:1-70"}, {"warmUp", "6-8:12-16"},
+  };
+  auto threadsParams = params;
+  threadsParams["threads"] = "2";
+
+  auto factory = cola::G4HandlerFactory();
+  auto serial = std::unique_ptr<cola::VFilter>(factory.create(params));
+  std::unique_ptr<cola::VFilter> parallel;
+  ASSERT_NO_THROW(parallel.reset(factory.create(threadsParams)));
+  auto& serialConverter = dynamic_cast<cola::VConverter&>(*serial);
+  auto& parallelConverter = dynamic_cast<cola::VConverter&>(*parallel);
+
+  const size_t events = 3;
+  for (size_t i = 0; i < events; ++i) {
+    const auto expected = serialConverter(SpectatorsEvent());
+    const auto result = parallelConverter(SpectatorsEvent());
+
+    ASSERT_EQ(result->particles.size(), expected->particles.size()) << "event " << i;
+    for (size_t j = 0; j < expected->particles.size(); ++j) {
+      EXPECT_TRUE(result->particles[j] == expected->particles[j]) << "event " << i << ", particle " << j;
+    }
+  }
+}
+
+TEST(TestModule, PipelineMatchesSerial) {
+  auto factory = cola::G4HandlerFactory();
+  auto serial = std::unique_ptr<cola::VFilter>(factory.create({{"streamSeed", "42"}}));
+  auto& serialConverter = dynamic_cast<cola::VConverter&>(*serial);
+  auto pipeline = cola::G4HandlerFactory::CreatePipeline(
+      {{"streamSeed", "42"}, {"pipelineThreads", "2"}, {"pipelineInFlight", "2"}});
+
+  // more events than in flight, so Run has to drain a full pipeline
+  const size_t eventsCount = 10;
+  auto generator = TestGenerator(SpectatorsEvent()->particles);
+  std::vector<std::unique_ptr<cola::EventData>> events;
+  auto writer = TestWriter(events);
+  pipeline->Run(generator, writer, eventsCount);
+
+  ASSERT_EQ(events.size(), eventsCount);
+  for (size_t i = 0; i < eventsCount; ++i) {
+    const auto expected = serialConverter(SpectatorsEvent());
+    ASSERT_EQ(events[i]->particles.size(), expected->particles.size()) << "event " << i;
+    for (size_t j = 0; j < expected->particles.size(); ++j) {
+      EXPECT_TRUE(events[i]->particles[j] == expected->particles[j]) << "event " << i << ", particle " << j;
+    }
+  }
+}
+
+TEST(TestModule, PipelineKeepsEventsAfterError) {
+  // without any model every excited spectator fails, events without spectators pass
+  auto pipeline = cola::G4HandlerPipeline([] {
+    const auto never = [](const G4Fragment&) { return false; };
+    auto handler = std::make_unique<ExcitationHandler>();
+    handler->SetMultiFragmentationCondition(never)
+        .SetFermiBreakUpCondition(never)
+        .SetEvaporationCondition(never)
+        .SetPhotonEvaporationCondition(never)
+        .SetNeutronDecayCondition(never);
+    return handler;
+  }, 2, 4);
+
+  pipeline.Submit(SpectatorsEvent());
+  pipeline.Submit(std::make_unique<cola::EventData>());
+  pipeline.Submit(SpectatorsEvent());
+  pipeline.Submit(std::make_unique<cola::EventData>());
+
+  // errors come in their turn and don't hide the events after them
+  EXPECT_THROW(pipeline.Receive(), std::runtime_error);
+  EXPECT_NE(pipeline.Receive(), nullptr);
+  EXPECT_THROW(pipeline.Receive(), std::runtime_error);
+  EXPECT_NE(pipeline.Receive(), nullptr);
+  EXPECT_EQ(pipeline.Receive(), nullptr);
+  EXPECT_EQ(pipeline.GetInFlight(), 0);
+}
+#endif
+
+TEST(TestModule, ColumnarRoundTrip) {
+  const auto path = (std::filesystem::temp_directory_path() / "deexcitation_columnar_test.bin").string();
+  std::filesystem::remove(path);
+
+  // odd particle counts exercise the padding, an empty event the repeated offsets
+  std::vector<cola::EventParticles> expected;
+  for (size_t i = 0; i < 5; ++i) {
+    auto particles = SpectatorsEvent()->particles;
+    particles.resize(i == 2 ? 0 : i + 1);
+    for (auto& particle : particles) {
+      particle.momentum.x = 0.5 * static_cast<double>(i);
+    }
+    expected.push_back(particles);
+  }
+
+  {
+    // 2 full chunks and a partial one written by the destructor
+    auto writer = cola::ColumnarWriter(path, 2);
+    for (const auto& particles : expected) {
+      auto event = std::make_unique<cola::EventData>();
+      event->particles = particles;
+      writer(std::move(event));
+    }
+  }
+  {
+    // reopening appends chunks after the existing ones
+    auto writer = cola::ColumnarWriter(path, 2);
+    auto event = std::make_unique<cola::EventData>();
+    event->particles = expected.front();
+    expected.push_back(expected.front());
+    writer(std::move(event));
+  }
+
+  const auto events = ReadColumnar(path);
+  ASSERT_EQ(events.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_EQ(events[i].size(), expected[i].size()) << "event " << i;
+    for (size_t j = 0; j < expected[i].size(); ++j) {
+      EXPECT_TRUE(events[i][j] == expected[i][j]) << "event " << i << ", particle " << j;
+    }
+  }
+  std::filesystem::remove(path);
+}
+
+TEST(TestModule, ColumnarRejectsForeignFile) {
+  const auto path = (std::filesystem::temp_directory_path() / "deexcitation_columnar_foreign.bin").string();
+  std::ofstream(path) << "not columnar";
+  EXPECT_THROW(cola::ColumnarWriter(path, 1), std::runtime_error);
+  std::filesystem::remove(path);
+}
@@ -3,12 +3,19 @@
 //
 
 #include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
 #include <memory>
+#include <new>
 #include <sstream>
 #include <stdexcept>
+#include <string>
 #include <string_view>
+#include <vector>
 
-#include "Deexcitation/handler/FermiBreakUpWrapper.h"
+#include "Deexcitation/handler/FbuFermiBreakUp.h"
 #include "FermiBreakUp/Splitter.h"
 #include "FermiBreakUp/util/DataTypes.h"
 #include "FermiBreakUp/util/Logger.h"
@@ -16,7 +23,74 @@
 #include "FermiBreakUp/util/Cache.h"
 #include "FermiBreakUp/FermiBreakUp.h"
 
+#include <G4Electron.hh>
+#include <G4GenericIon.hh>
+#include <G4IonTable.hh>
+#include <G4ParticleTable.hh>
+
 #include "Deexcitation/handler/ExcitationHandler.h"
+#include "Deexcitation/handler/HandlerPool.h"
+
+namespace {
+  std::atomic<size_t> AllocationCount = 0;
+
+  // nuclides up to maxA with E*/A of 1..10 MeV, reproducible for a seed
+  std::vector<G4Fragment> RandomFragments(int seed, size_t count, int maxA = 100) {
+    srand(seed);
+    std::vector<G4Fragment> fragments;
+    fragments.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      const G4int mass = rand() % maxA + 1;
+      const G4int charge = rand() % (mass + 1);
+      const G4double energy = (rand() % 10 + 1) * CLHEP::MeV * mass;
+      fragments.emplace_back(mass, charge, G4LorentzVector(0, 0, 0, G4NucleiProperties::GetNuclearMass(mass, charge) + energy));
+    }
+    return fragments;
+  }
+
+  // decays a moving cluster of A neutrons, checks every decay and returns mean squared neutron momentum in its rest frame
+  G4double CheckNeutronDecays(NeutronDecay& decay, G4int A, size_t runs) {
+    const auto restEnergy = A * CLHEP::neutron_mass_c2 + 2 * CLHEP::MeV * A;
+    const auto pz = 500 * CLHEP::MeV;
+    const auto momentum = G4LorentzVector(0, 0, pz, std::sqrt(restEnergy * restEnergy + pz * pz));
+    const auto cluster = G4Fragment(A, 0, momentum);
+
+    G4double momentumSquared = 0;
+    G4FragmentVector results;
+    for (size_t i = 0; i < runs; ++i) {
+      results.clear();
+      decay.BreakFragment(results, cluster);
+      EXPECT_EQ(results.size(), static_cast<size_t>(A));
+
+      G4LorentzVector total;
+      for (const auto neutron : results) {
+        EXPECT_NEAR(neutron->GetMomentum().m(), CLHEP::neutron_mass_c2, 1e-4 * CLHEP::MeV) << "neutron is off-shell";
+        total += neutron->GetMomentum();
+        momentumSquared += G4LorentzVector(neutron->GetMomentum()).boost(-momentum.boostVector()).vect().mag2();
+        delete neutron;
+      }
+      EXPECT_NEAR((total - momentum).e(), 0, 1e-6 * momentum.e()) << "violates energy conservation";
+      EXPECT_NEAR((total - momentum).vect().mag(), 0, 1e-6 * momentum.e()) << "violates momentum conservation";
+    }
+    return momentumSquared / (runs * A);
+  }
+} // namespace
+
+void* operator new(std::size_t size) {
+  ++AllocationCount;
+  if (auto ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
 
 namespace {
   std::unique_ptr<fbu::FermiBreakUp::SplitCache> GetCache(const std::string_view name) {
@@ -50,7 +124,7 @@ namespace {
 
 TEST_P(ConfigurationsFixture, MassAndChargeConservation) {
   auto model = ExcitationHandler();
-  auto fbuModel = std::make_unique<FermiBreakUpWrapper>(fbu::FermiBreakUp(GetCache(ConfigurationsFixture::GetParam())));
+  auto fbuModel = std::make_unique<FbuFermiBreakUp>(fbu::FermiBreakUp(GetCache(ConfigurationsFixture::GetParam())));
   fbuModel->Initialise();
   model.SetFermiBreakUp(std::move(fbuModel));
   const int seed = 1;
@@ -84,10 +158,449 @@ TEST_P(ConfigurationsFixture, MassAndChargeConservation) {
   }
 }
 
+TEST(BatchTest, MassConservationPerFragment) {
+  auto model = ExcitationHandler();
+  const auto fragments = RandomFragments(3, 50);
+
+  ExcitationHandler::BatchResult result;
+  model.BreakItUp(fragments, result);
+
+  ASSERT_EQ(result.offsets.size(), fragments.size() + 1);
+  ASSERT_EQ(result.offsets.back(), result.products.size());
+  for (size_t i = 0; i < fragments.size(); ++i) {
+    G4int massTotal = 0;
+    for (auto idx = result.offsets[i]; idx < result.offsets[i + 1]; ++idx) {
+      massTotal += result.products[idx].GetDefinition()->GetAtomicMass();
+    }
+    ASSERT_EQ(massTotal, fragments[i].GetA_asInt()) << "violates mass conservation in batch entry " << i;
+  }
+}
+
+TEST(BatchTest, StagedConservationPerFragment) {
+  auto model = ExcitationHandler();
+  const auto fragments = RandomFragments(5, 50);
+  const size_t runs = 1e2;
+
+  std::vector<G4int> chargeTotal(fragments.size(), 0);
+  for (size_t run = 0; run < runs; ++run) {
+    std::vector<G4int> massTotal(fragments.size(), 0);
+    size_t lastIdx = 0;
+    model.BreakItUpStaged(fragments, [&](size_t fragmentIdx, const G4Fragment& fragment) {
+      ASSERT_GE(fragmentIdx, lastIdx) << "products are not grouped by fragment";
+      lastIdx = fragmentIdx;
+      massTotal[fragmentIdx] += fragment.GetA_asInt();
+      chargeTotal[fragmentIdx] += fragment.GetZ_asInt();
+    });
+
+    for (size_t i = 0; i < fragments.size(); ++i) {
+      ASSERT_EQ(massTotal[i], fragments[i].GetA_asInt()) << "violates mass conservation in batch entry " << i;
+    }
+  }
+
+  // test mean, because of multifragmentation model
+  for (size_t i = 0; i < fragments.size(); ++i) {
+    const auto charge = fragments[i].GetZ_asInt();
+    ASSERT_NEAR(G4double(chargeTotal[i]) / runs, charge, 2 * charge / std::sqrt(runs))
+        << "violates charge conservation in batch entry " << i;
+  }
+}
+
+TEST(NeutronDecayTest, FastPathsMatchGeneral) {
+  const size_t runs = 1e4;
+  for (const G4int A : {2, 3}) {
+    auto fast = NeutronDecay();
+    auto general = NeutronDecay();
+    general.SetFastPaths(false);
+
+    const auto fastMomentum = CheckNeutronDecays(fast, A, runs);
+    const auto generalMomentum = CheckNeutronDecays(general, A, runs);
+
+    // both sample the same phase space
+    EXPECT_NEAR(fastMomentum, generalMomentum, 0.05 * generalMomentum) << "A = " << A;
+  }
+}
+
+TEST(StaticHandlerTest, MassConservation) {
+  auto model = StaticExcitationHandler();
+  const size_t tries = 10;
+  const size_t runs = 1e2;
+
+  for (const auto& particle : RandomFragments(5, tries)) {
+    const auto mass = particle.GetA_asInt();
+    const auto charge = particle.GetZ_asInt();
+    for (size_t i = 0; i < runs; ++i) {
+      G4int massTotal = 0;
+      for (const auto& fragment : model.BreakItUp(particle)) {
+        massTotal += fragment.GetDefinition()->GetAtomicMass();
+      }
+
+      ASSERT_EQ(massTotal, mass) << "violates mass conservation: " << mass << ' ' << charge;
+    }
+  }
+}
+
+TEST(AllocationTest, SteadyStateBreakItUp) {
+  auto model = ExcitationHandler();
+  // the same stream every call, so each call takes the same evaporation, fermi and photon path
+  model.EnableRandomStreams(11);
+  const G4int mass = 24;
+  const G4int charge = 12;
+  const auto particle =
+      G4Fragment(mass, charge, G4LorentzVector(0, 0, 0, G4NucleiProperties::GetNuclearMass(mass, charge) + 2 * CLHEP::MeV * mass));
+  const size_t warmUp = 10;
+  const size_t runs = 1e3;
+
+  std::vector<G4ReactionProduct> products;
+  const auto warmUpBefore = AllocationCount.load();
+  for (size_t i = 0; i < warmUp; ++i) {
+    products.clear();
+    model.SetStreamPosition(0, 0);
+    model.BreakItUp(particle, products);
+  }
+  const auto warmUpAllocations = AllocationCount.load() - warmUpBefore;
+  ASSERT_GT(products.size(), 2) << "nucleus must go through the stage queues";
+
+  const auto before = AllocationCount.load();
+  for (size_t i = 0; i < runs; ++i) {
+    products.clear();
+    model.SetStreamPosition(0, 0);
+    model.BreakItUp(particle, products);
+  }
+
+  // scratch buffers and the output vector are reused, fragments come from the arena and G4Allocator pools,
+  // so steady state calls allocate nothing per call: the whole run stays within what the warm-up needed once
+  EXPECT_LE(AllocationCount.load() - before, warmUpAllocations);
+}
+
+TEST(AllocationTest, ArenaCountsEveryFragment) {
+  auto arena = FragmentArena();
+  const auto momentum = G4LorentzVector(0, 0, 0, G4NucleiProperties::GetNuclearMass(4, 2));
+
+  // more than a block, so fragments land both in fresh and in reused blocks
+  const size_t count = 100;
+  for (size_t i = 0; i < count; ++i) {
+    arena.Destroy(arena.Create(4, 2, momentum));
+  }
+  EXPECT_EQ(arena.GetAvoidedAllocations(), count);
+  const auto blocks = arena.GetBlockAllocations();
+
+  arena.Reset();
+  for (size_t i = 0; i < count; ++i) {
+    arena.Destroy(arena.Create(4, 2, momentum));
+  }
+  EXPECT_EQ(arena.GetAvoidedAllocations(), 2 * count);
+  EXPECT_EQ(arena.GetBlockAllocations(), blocks);
+}
+
+TEST(StatsTest, StageProductsSumToResults) {
+  auto model = ExcitationHandler();
+  model.EnableStats();
+
+  // every product of an excited input comes out of exactly one stage
+  size_t products = 0;
+  size_t inputs = 0;
+  for (const auto& fragment : RandomFragments(17, 50)) {
+    if (fragment.GetA_asInt() <= 1) {
+      continue;
+    }
+    products += model.BreakItUp(fragment).size();
+    ++inputs;
+  }
+
+  const auto& stats = model.GetStats();
+  size_t stageProducts = 0;
+  for (size_t stage = 0; stage < HandlerStats::StageCount; ++stage) {
+    stageProducts += stats.stages[stage].products;
+  }
+  EXPECT_EQ(stageProducts, products);
+  EXPECT_GT(stats.stages[HandlerStats::Evaporation].calls, 0);
+  EXPECT_GT(stats.stages[HandlerStats::Evaporation].time.count(), 0);
+  EXPECT_GT(stats.stages[HandlerStats::FermiBreakUp].calls, 0);
+  EXPECT_GT(stats.stages[HandlerStats::PhotonEvaporation].calls, 0);
+
+  size_t recorded = 0;
+  for (const auto count : stats.evaporationIterations) {
+    recorded += count;
+  }
+  EXPECT_LE(recorded, inputs);
+  EXPECT_GT(recorded, 0);
+}
+
+TEST(StatsTest, NestedScopes) {
+  HandlerStats stats;
+  G4FragmentVector results;
+  G4FragmentVector otherResults;
+  {
+    const auto outer = StageScope(&stats.stages[HandlerStats::Evaporation], results);
+    results.push_back(nullptr);
+    {
+      // booked to its own stage only
+      const auto inner = StageScope(&stats.stages[HandlerStats::NeutronDecay], results);
+      results.push_back(nullptr);
+      results.push_back(nullptr);
+    }
+    {
+      // products of another vector are not the outer scope's
+      const auto inner = StageScope(&stats.stages[HandlerStats::FermiBreakUp], otherResults);
+      otherResults.push_back(nullptr);
+    }
+    results.push_back(nullptr);
+  }
+
+  EXPECT_EQ(stats.stages[HandlerStats::Evaporation].calls, 1);
+  EXPECT_EQ(stats.stages[HandlerStats::Evaporation].products, 2);
+  EXPECT_EQ(stats.stages[HandlerStats::NeutronDecay].calls, 1);
+  EXPECT_EQ(stats.stages[HandlerStats::NeutronDecay].products, 2);
+  EXPECT_EQ(stats.stages[HandlerStats::FermiBreakUp].products, 1);
+
+  // the outer scope is closed, so a new one has no parent
+  {
+    const auto scope = StageScope(&stats.stages[HandlerStats::PhotonEvaporation], results);
+    results.push_back(nullptr);
+  }
+  EXPECT_EQ(stats.stages[HandlerStats::PhotonEvaporation].products, 1);
+  EXPECT_EQ(stats.stages[HandlerStats::Evaporation].products, 2);
+  EXPECT_GE(stats.stages[HandlerStats::Evaporation].time.count(), 0);
+}
+
+TEST(BudgetTest, FallbackKeepsMass) {
+  auto model = ExcitationHandler();
+  model.SetWorkBudget(ExcitationHandler::WorkBudget{1, std::chrono::nanoseconds(0)});
+  model.SetMultiFragmentationCondition([](const G4Fragment&) { return false; });
+
+  const G4int mass = 100;
+  const G4int charge = 45;
+  const auto particle =
+      G4Fragment(mass, charge, G4LorentzVector(0, 0, 0, G4NucleiProperties::GetNuclearMass(mass, charge) + 3 * CLHEP::MeV * mass));
+  const size_t runs = 10;
+  for (size_t i = 0; i < runs; ++i) {
+    G4int massTotal = 0;
+    for (const auto& fragment : model.BreakItUp(particle)) {
+      massTotal += fragment.GetDefinition()->GetAtomicMass();
+    }
+
+    ASSERT_EQ(massTotal, mass) << "violates mass conservation with exhausted budget";
+  }
+  EXPECT_GT(model.GetFallbackCount(), 0);
+}
+
+TEST(BudgetTest, RejectsUnlimited) {
+  auto model = ExcitationHandler();
+  EXPECT_THROW(model.SetWorkBudget(ExcitationHandler::WorkBudget{0, std::chrono::nanoseconds(0)}), std::runtime_error);
+  EXPECT_FALSE(model.GetWorkBudget().has_value());
+}
+
+TEST(RandomStreamTest, OrderIndependent) {
+  auto model = ExcitationHandler();
+  model.EnableRandomStreams(42);
+  const auto fragments = RandomFragments(7, 10);
+
+  ExcitationHandler::BatchResult forward;
+  model.SetStreamPosition(0, 0);
+  model.BreakItUp(fragments, forward);
+
+  // same streams in reverse order
+  for (size_t i = fragments.size(); i-- > 0;) {
+    model.SetStreamPosition(0, i);
+    const auto products = model.BreakItUp(fragments[i]);
+
+    ASSERT_EQ(products.size(), forward.offsets[i + 1] - forward.offsets[i]) << "fragment " << i;
+    for (size_t j = 0; j < products.size(); ++j) {
+      const auto& expected = forward.products[forward.offsets[i] + j];
+      EXPECT_EQ(products[j].GetDefinition(), expected.GetDefinition());
+      EXPECT_EQ(products[j].GetTotalEnergy(), expected.GetTotalEnergy());
+      EXPECT_EQ(products[j].GetMomentum(), expected.GetMomentum());
+    }
+  }
+}
+
+#ifdef G4MULTITHREADED
+TEST(ParallelEvaporationTest, MatchesSerialEvaporation) {
+  const HandlerPool::Builder builder = [] {
+    auto handler = std::make_unique<ExcitationHandler>();
+    handler->EnableRandomStreams(17);
+    return handler;
+  };
+  // a single worker evaporates the same tasks one after another
+  auto serialPool = HandlerPool(builder, 1);
+  auto parallelPool = HandlerPool(builder, 4);
+  auto serial = builder();
+  auto parallel = builder();
+  serial->SetParallelEvaporation(&serialPool, 2);
+  parallel->SetParallelEvaporation(&parallelPool, 2);
+
+  // heavy and hot, so multifragmentation always applies and the pool is used
+  const G4int nuclides[][2] = {{100, 44}, {150, 62}, {200, 80}};
+  const size_t runs = 20;
+  for (const auto& [mass, charge] : nuclides) {
+    const auto particle =
+        G4Fragment(mass, charge, G4LorentzVector(0, 0, 0, G4NucleiProperties::GetNuclearMass(mass, charge) + 8 * CLHEP::MeV * mass));
+    G4int chargeTotal = 0;
+    for (size_t run = 0; run < runs; ++run) {
+      std::vector<G4Fragment> expected;
+      serial->SetStreamPosition(0, run);
+      serial->BreakItUpFragments(particle, [&expected](const G4Fragment& fragment) { expected.push_back(fragment); });
+
+      std::vector<G4Fragment> result;
+      parallel->SetStreamPosition(0, run);
+      parallel->BreakItUpFragments(particle, [&result](const G4Fragment& fragment) { result.push_back(fragment); });
+
+      ASSERT_EQ(result.size(), expected.size()) << "A = " << mass << ", run " << run;
+      G4int massTotal = 0;
+      for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(result[i].GetA_asInt(), expected[i].GetA_asInt()) << "A = " << mass << ", run " << run << ", product " << i;
+        EXPECT_EQ(result[i].GetZ_asInt(), expected[i].GetZ_asInt()) << "A = " << mass << ", run " << run << ", product " << i;
+        EXPECT_EQ(result[i].GetMomentum(), expected[i].GetMomentum()) << "A = " << mass << ", run " << run << ", product " << i;
+        massTotal += result[i].GetA_asInt();
+        chargeTotal += result[i].GetZ_asInt();
+      }
+      ASSERT_EQ(massTotal, mass) << "violates mass conservation with parallel evaporation";
+    }
+
+    // test mean, because of multifragmentation model
+    ASSERT_NEAR(G4double(chargeTotal) / runs, charge, 2 * charge / std::sqrt(runs))
+        << "violates charge conservation with parallel evaporation";
+  }
+}
+#endif
+
+TEST(FragmentSinkTest, MatchReactionProducts) {
+  auto model = ExcitationHandler();
+  model.EnableRandomStreams(19);
+  const auto fragments = RandomFragments(11, 20);
+
+  std::vector<G4Fragment> finalFragments;
+  for (size_t i = 0; i < fragments.size(); ++i) {
+    model.SetStreamPosition(0, i);
+    const auto products = model.BreakItUp(fragments[i]);
+
+    // same stream position, so the same breakup
+    finalFragments.clear();
+    model.SetStreamPosition(0, i);
+    model.BreakItUpFragments(fragments[i], [&finalFragments](const G4Fragment& fragment) {
+      finalFragments.push_back(fragment);
+    });
+
+    ASSERT_EQ(finalFragments.size(), products.size()) << "fragment " << i;
+    for (size_t j = 0; j < products.size(); ++j) {
+      const auto& momentum = finalFragments[j].GetMomentum();
+      EXPECT_EQ(momentum.vect(), products[j].GetMomentum()) << "fragment " << i << ", product " << j;
+      EXPECT_EQ(momentum.e(), products[j].GetTotalEnergy()) << "fragment " << i << ", product " << j;
+      if (products[j].GetDefinition()->GetAtomicMass() > 0) {
+        EXPECT_EQ(finalFragments[j].GetA_asInt(), products[j].GetDefinition()->GetAtomicMass()) << "fragment " << i << ", product " << j;
+        EXPECT_EQ(finalFragments[j].GetZ_asInt(), products[j].GetDefinition()->GetAtomicNumber()) << "fragment " << i << ", product " << j;
+      }
+    }
+  }
+}
+
+TEST(ProductColumnsTest, MatchReactionProducts) {
+  auto model = ExcitationHandler();
+  model.EnableRandomStreams(13);
+  const auto fragments = RandomFragments(9, 10);
+
+  ProductColumns columns;
+  for (size_t i = 0; i < fragments.size(); ++i) {
+    model.SetStreamPosition(0, i);
+    const auto products = model.BreakItUp(fragments[i]);
+
+    // same stream position, so the same breakup
+    columns.Clear();
+    model.SetStreamPosition(0, i);
+    model.BreakItUp(fragments[i], columns);
+
+    ASSERT_EQ(columns.Size(), products.size()) << "fragment " << i;
+    for (size_t j = 0; j < products.size(); ++j) {
+      const auto definition = products[j].GetDefinition();
+      // nuclei, nucleons among them, carry their atomic number, gammas and conversion electrons their charge
+      const auto expectedZ = definition->GetBaryonNumber() > 0 ? definition->GetAtomicNumber()
+                           : definition == G4Electron::Definition() ? -1 : 0;
+      EXPECT_EQ(columns.pdg[j], definition->GetPDGEncoding()) << "fragment " << i << ", product " << j;
+      EXPECT_EQ(columns.A[j], definition->GetBaryonNumber()) << "fragment " << i << ", product " << j;
+      EXPECT_EQ(columns.Z[j], expectedZ) << "fragment " << i << ", product " << j;
+      EXPECT_EQ(columns.px[j], products[j].GetMomentum().x()) << "fragment " << i << ", product " << j;
+      EXPECT_EQ(columns.py[j], products[j].GetMomentum().y()) << "fragment " << i << ", product " << j;
+      EXPECT_EQ(columns.pz[j], products[j].GetMomentum().z()) << "fragment " << i << ", product " << j;
+      EXPECT_EQ(columns.e[j], products[j].GetTotalEnergy()) << "fragment " << i << ", product " << j;
+      EXPECT_EQ(columns.t[j], products[j].GetFormationTime()) << "fragment " << i << ", product " << j;
+    }
+  }
+}
+
+TEST(StartupTest, LazyIonTable) {
+  auto model = ExcitationHandler(IonTableMode::Lazy);
+  model.PrewarmIons(NuclideRange{1, 20, 1, 50});
+  RecordProperty("LazyStartupSeconds", std::to_string(model.GetStartupTime().count()));
+
+  const auto particle = G4Fragment(40, 20, G4LorentzVector(0, 0, 0, G4NucleiProperties::GetNuclearMass(40, 20) + 40 * CLHEP::MeV));
+  const size_t runs = 1e2;
+  for (size_t i = 0; i < runs; ++i) {
+    G4int massTotal = 0;
+    for (const auto& fragment : model.BreakItUp(particle)) {
+      massTotal += fragment.GetDefinition()->GetAtomicMass();
+    }
+
+    ASSERT_EQ(massTotal, 40) << "violates mass conservation in lazy ion table mode";
+  }
+  EXPECT_GT(model.GetIonCache().GetHits(), 0);
+}
+
+TEST(StartupTest, WarmUpKeepsStreams) {
+  auto cold = ExcitationHandler();
+  auto warm = ExcitationHandler();
+  cold.EnableRandomStreams(23).EnableStats();
+  warm.EnableRandomStreams(23).EnableStats();
+  ASSERT_NO_THROW(warm.WarmUp(NuclideRange{1, 30, 1, 70}));
+  EXPECT_GT(warm.GetWarmUpTime().count(), 0);
+  for (const auto& stage : warm.GetStats().stages) {
+    EXPECT_EQ(stage.calls, 0) << "trial breakups are counted in stats";
+  }
+
+  // trial breakups draw from their own engine, so the streams are untouched
+  const auto fragments = RandomFragments(13, 10, 70);
+  for (size_t i = 0; i < fragments.size(); ++i) {
+    const auto expected = cold.BreakItUp(fragments[i]);
+    const auto products = warm.BreakItUp(fragments[i]);
+
+    ASSERT_EQ(products.size(), expected.size()) << "fragment " << i;
+    for (size_t j = 0; j < products.size(); ++j) {
+      EXPECT_EQ(products[j].GetDefinition(), expected[j].GetDefinition()) << "fragment " << i << ", product " << j;
+      EXPECT_EQ(products[j].GetTotalEnergy(), expected[j].GetTotalEnergy()) << "fragment " << i << ", product " << j;
+      EXPECT_EQ(products[j].GetMomentum(), expected[j].GetMomentum()) << "fragment " << i << ", product " << j;
+    }
+  }
+  for (size_t stage = 0; stage < HandlerStats::StageCount; ++stage) {
+    EXPECT_EQ(warm.GetStats().stages[stage].calls, cold.GetStats().stages[stage].calls) << HandlerStats::StageName(HandlerStats::Stage(stage));
+  }
+}
+
+TEST(StartupTest, SharedParticleEnvironment) {
+  const auto first = ExcitationHandler();
+  const auto particleTable = G4ParticleTable::GetParticleTable();
+  const auto particles = particleTable->entries();
+  const auto ions = particleTable->GetIonTable()->Entries();
+  const auto processManager = G4GenericIon::GenericIon()->GetProcessManager();
+  const auto setupTime = ParticleEnvironment::GetSetupTime();
+  const size_t handlers = 5;
+
+  std::chrono::duration<double> total{};
+  for (size_t i = 0; i < handlers; ++i) {
+    total += ExcitationHandler().GetStartupTime();
+  }
+  RecordProperty("HandlersStartupSeconds", std::to_string(total.count()));
+  RecordProperty("SetupSeconds", std::to_string(setupTime.count()));
+
+  // only models are built again, particles and ions are shared
+  EXPECT_EQ(particleTable->entries(), particles);
+  EXPECT_EQ(particleTable->GetIonTable()->Entries(), ions);
+  EXPECT_EQ(G4GenericIon::GenericIon()->GetProcessManager(), processManager);
+  EXPECT_EQ(ParticleEnvironment::GetSetupTime(), setupTime);
+}
+
 // Is doesn't work because of multi-fragmentation model *(
 // TEST_P(ConfigurationsFixture, Vector4Conservation) {
 //   auto model = ExcitationHandler();
-//   auto fbuModel = std::make_unique<FermiBreakUpWrapper>(fbu::FermiBreakUp(GetCache(ConfigurationsFixture::GetParam())));
+//   auto fbuModel = std::make_unique<FbuFermiBreakUp>(fbu::FermiBreakUp(GetCache(ConfigurationsFixture::GetParam())));
 //   fbuModel->Initialise();
 //   model.SetFermiBreakUp(std::move(fbuModel));
 //   const int seed = 7;